@@ -0,0 +1,234 @@
+# This file is a part of the XVM Project
+# Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+# Generates src/xvm_superinsn.h from opcode profiles.
+#
+# Profiles are recorded by building the interpreter with XVM_OPCODE_PROFILE=1, running a workload
+# and writing xvm::dumpOpcodeProfile() output to a file. Each profile line is either
+# "pair <count> <op0> <op1>" or "triple <count> <op0> <op1> <op2>", with numeric opcodes.
+#
+# The most frequent sequences are turned into superinstructions. A fused handler is the handler of
+# the first opcode, with its dispatch replaced by a direct jump into the handler of the next one.
+# Only opcodes whose handlers always fall through to the next instruction can start a sequence.
+
+import argparse
+import os
+import re
+from utils import log_message
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+OPCODE_HEADER = os.path.join(ROOT, "src", "xvm_opcode.h")
+EXECUTE_SOURCE = os.path.join(ROOT, "src", "xvm_execute.cpp")
+OUTPUT_HEADER = os.path.join(ROOT, "src", "xvm_superinsn.h")
+
+# Sequences used when no profile is given. None are fused until a profile of a representative
+# workload is recorded.
+DEFAULT_SEQUENCES = []
+
+# Handler constructs that transfer control somewhere other than the next instruction, or that
+# depend on the opcode of the executing instruction.
+NON_FUSABLE = [
+    "goto",
+    "static",
+    "pc->op",
+    "VM_DISPATCH",
+    "VM_JUMP",
+    "VM_LOAD",
+    "VM_CHECK_RETURN",
+    "VM_QUICKEN",
+    "VM_DEQUICKEN",
+    "VM_FUSED_NEXT",
+]
+
+LINE_WIDTH = 100
+
+
+def parse_opcodes():
+    with open(OPCODE_HEADER) as f:
+        source = f.read()
+
+    body = re.search(r"enum class Opcode : uint16_t \{(.*?)\};", source, re.S).group(1)
+    opcodes = []
+
+    for line in body.splitlines():
+        line = line.strip()
+        # Superinstructions are appended by the generated list, and are never profiled.
+        if line.startswith("XVM_SUPERINSN_LIST"):
+            break
+
+        match = re.match(r"^([A-Z0-9_]+),$", line)
+        if match:
+            opcodes.append(match.group(1))
+
+    return opcodes
+
+
+def parse_handlers():
+    with open(EXECUTE_SOURCE) as f:
+        lines = f.read().splitlines()
+
+    handlers = {}
+    labels = []
+    i = 0
+
+    while i < len(lines):
+        match = re.match(r"^\s*VM_CASE\( (\w+) \)( \{)?$", lines[i])
+        if not match:
+            labels = []
+            i += 1
+            continue
+
+        labels.append(match.group(1))
+        if not match.group(2):
+            i += 1
+            continue
+
+        depth = 1
+        body = []
+        i += 1
+
+        while depth > 0:
+            depth += lines[i].count("{") - lines[i].count("}")
+            if depth > 0:
+                body.append(lines[i])
+            i += 1
+
+        for label in labels:
+            handlers[label] = body
+
+        labels = []
+
+    return handlers
+
+
+def is_fusable(body):
+    text = "\n".join(body)
+    return "VM_NEXT()" in text and not any(construct in text for construct in NON_FUSABLE)
+
+
+def is_continuable(body):
+    # Quickening rewrites the opcode of an instruction in place, after which a direct jump into the
+    # generic handler would execute it with the quickened opcode.
+    return bool(body) and "VM_QUICKEN" not in "\n".join(body)
+
+
+def read_profiles(paths, opcodes):
+    pairs = {}
+    triples = {}
+
+    for path in paths:
+        with open(path) as f:
+            for line in f:
+                fields = line.split()
+                if not fields:
+                    continue
+
+                kind, count = fields[0], int(fields[1])
+                ops = tuple(opcodes[int(op)] for op in fields[2:])
+                table = pairs if kind == "pair" else triples
+                table[ops] = table.get(ops, 0) + count
+
+    return pairs, triples
+
+
+def select_sequences(pairs, triples, handlers, count):
+    def fusable(seq):
+        return all(is_fusable(handlers.get(op, [])) for op in seq[:-1]) and all(
+            is_continuable(handlers.get(op, [])) for op in seq[1:]
+        )
+
+    ranked = sorted(pairs.items(), key=lambda item: -item[1]) + sorted(
+        triples.items(), key=lambda item: -item[1]
+    )
+    selected = []
+
+    for seq, _ in sorted(ranked, key=lambda item: -item[1]):
+        if len(selected) >= count:
+            break
+
+        if seq in selected or not fusable(seq):
+            continue
+
+        # A fused triple continues into the fused pair of its tail.
+        if len(seq) == 3 and seq[1:] not in selected:
+            if len(selected) + 2 > count:
+                continue
+            selected.append(seq[1:])
+
+        selected.append(seq)
+
+    return selected
+
+
+def superinsn_name(seq):
+    return "_".join(seq)
+
+
+def emit_macro(name, params, entries):
+    lines = [f"#define {name}( {params} )"] + [f"  {entry}" for entry in entries]
+    return "\n".join(
+        line.ljust(LINE_WIDTH - 1) + "\\" if i < len(lines) - 1 else line for i, line in enumerate(lines)
+    )
+
+
+def emit_handler(seq, handlers):
+    target = superinsn_name(seq[1:]) if len(seq) == 3 else seq[1]
+    body = [line.replace("VM_NEXT()", f"VM_FUSED_NEXT( {target} )") for line in handlers[seq[0]]]
+    return "\n".join([f"VM_CASE( {superinsn_name(seq)} ) {{"] + [line[4:] for line in body] + ["}"])
+
+
+def generate(sequences, handlers):
+    entries = []
+    for seq in sequences:
+        ops = list(seq) + ["NOP"] * (3 - len(seq))
+        entries.append(f"X( {superinsn_name(seq)}, {len(seq)}, {', '.join(ops)} )")
+
+    out = [
+        "// This file is a part of the XVM project",
+        "// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0",
+        "",
+        "// Generated by scripts/superinsn.py, do not edit.",
+        "",
+        "#ifndef XVM_SUPERINSN_H",
+        "#define XVM_SUPERINSN_H",
+        "",
+        "// X( name, length, op0, op1, op2 ); unused trailing opcodes are NOP.",
+        emit_macro("XVM_SUPERINSN_LIST", "X", entries),
+        "",
+        "#endif",
+        "",
+        "// Fused handlers, expanded inside the interpreter loop.",
+        "#ifdef XVM_SUPERINSN_HANDLERS",
+    ]
+
+    for seq in sequences:
+        out += ["", emit_handler(seq, handlers)]
+
+    out += ["", "#endif", ""]
+    return "\n".join(out)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Generate superinstructions from opcode profiles")
+    parser.add_argument("profiles", nargs="*", help="opcode profile dumps")
+    parser.add_argument("-n", "--count", type=int, default=16, help="number of superinstructions")
+    args = parser.parse_args()
+
+    opcodes = parse_opcodes()
+    handlers = parse_handlers()
+
+    if args.profiles:
+        pairs, triples = read_profiles(args.profiles, opcodes)
+    else:
+        log_message("no profiles given, using default sequences")
+        pairs, triples = {seq: 1 for seq in DEFAULT_SEQUENCES}, {}
+
+    sequences = select_sequences(pairs, triples, handlers, args.count)
+    if not sequences:
+        log_message("no fusable sequences found")
+
+    with open(OUTPUT_HEADER, "w") as f:
+        f.write(generate(sequences, handlers))
+
+    for seq in sequences:
+        log_message(f"fused {' '.join(seq)}")
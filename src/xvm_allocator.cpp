@@ -66,6 +66,68 @@ TempObj<T>::TempObj(TempObj<T>&& other)
 
 // clang-format on
 
+struct PoolBlock {
+  PoolBlock* next;
+};
+
+static constexpr size_t kPoolClassCount = ObjectPool::kMaxSize / ObjectPool::kGranularity;
+
+// Free lists of a thread. Blocks still cached when the thread exits are returned to the system;
+// blocks freed after that, by objects destroyed later during thread exit, bypass the cache.
+struct PoolCache {
+  PoolBlock* heads[kPoolClassCount] = {};
+  size_t counts[kPoolClassCount] = {};
+
+  ~PoolCache();
+};
+
+static thread_local PoolCache poolCache;
+static thread_local bool poolCacheDestroyed = false;
+
+PoolCache::~PoolCache() {
+  for ( PoolBlock* head : heads ) {
+    while ( head != NULL ) {
+      PoolBlock* next = head->next;
+      ::operator delete( head );
+      head = next;
+    }
+  }
+
+  poolCacheDestroyed = true;
+}
+
+void* ObjectPool::alloc( size_t size ) {
+  if ( size > kMaxSize ) {
+    return ::operator new( size );
+  }
+
+  size_t cls = ( size - 1 ) / kGranularity;
+
+  PoolBlock* block = poolCache.heads[cls];
+  if ( block != NULL ) {
+    poolCache.heads[cls] = block->next;
+    poolCache.counts[cls]--;
+    return block;
+  }
+
+  // Allocate the full size class, so that the block can be reused by any object of the class.
+  return ::operator new( ( cls + 1 ) * kGranularity );
+}
+
+void ObjectPool::free( void* ptr, size_t size ) {
+  size_t cls = ( size - 1 ) / kGranularity;
+
+  if ( size > kMaxSize || poolCacheDestroyed || poolCache.counts[cls] == kMaxCached ) {
+    ::operator delete( ptr );
+    return;
+  }
+
+  PoolBlock* block = static_cast<PoolBlock*>( ptr );
+  block->next = poolCache.heads[cls];
+  poolCache.heads[cls] = block;
+  poolCache.counts[cls]++;
+}
+
 template<typename T>
 LinearAllocator<T>::~LinearAllocator() {
   for ( auto& dtor : dtorMap ) {
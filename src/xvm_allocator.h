@@ -69,6 +69,19 @@ public:
   const T* operator->() const;
 };
 
+// Recycles the memory of small heap objects through per-thread free lists, one for each size class.
+// Freed blocks are kept for reuse instead of being returned to the system, so that allocating the
+// short-lived objects scripts create in bulk is a free list pop.
+class ObjectPool {
+public:
+  static constexpr size_t kGranularity = 16; // Width of a size class
+  static constexpr size_t kMaxSize = 256;    // Larger objects bypass the pool
+  static constexpr size_t kMaxCached = 4096; // Free blocks kept per size class
+
+  static void* alloc( size_t size );
+  static void free( void* ptr, size_t size );
+};
+
 template<typename T>
 class Allocator {
 public:
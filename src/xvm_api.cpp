@@ -61,4 +61,10 @@ const Value& getGlobal( const State& state, const char* name ) {
   return state.globalEnv->get( name );
 }
 
+void dumpOpcodeProfile( const State& state, std::ostream& out ) {
+#if XVM_OPCODE_PROFILE
+  impl::__dumpOpcodeProfile( &state.opcodeProfile, out );
+#endif
+}
+
 } // namespace xvm
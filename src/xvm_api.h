@@ -17,9 +17,9 @@ std::string toString( const Value& val );
 
 bool toBool( const Value& val );
 
-int toInt( const Value& val );
+Integer toInt( const Value& val );
 
-float toFloat( const Value& val );
+Real toFloat( const Value& val );
 
 bool compare( const Value& val );
 
@@ -29,7 +29,7 @@ Value clone( const Value& val );
 
 void reset( Value& val );
 
-int length( const Value& val );
+Integer length( const Value& val );
 
 void execute( State& state );
 
@@ -67,6 +67,8 @@ void pcall( State& state, const Closure& callee, size_t argc );
 
 void ret( State& state, Value&& retv );
 
+void dumpOpcodeProfile( const State& state, std::ostream& out );
+
 } // namespace xvm
 
 #endif
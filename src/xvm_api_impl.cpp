@@ -3,8 +3,14 @@
 
 #include "xvm_api_impl.h"
 #include "xvm_string.h"
+#include <algorithm>
+#include <bit>
 #include <cmath>
 
+#if XVM_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace xvm {
 
 namespace impl {
@@ -37,9 +43,9 @@ void __ethrow( State* state, const std::string& message ) {
   const Callable& c = ( state->callInfoTop - 1 )->closure->callee;
   const std::string func = __getFuncSig( c );
 
-  state->errorInfo->error = true;
-  state->errorInfo->func = state->stringAtor.fromArray( func.c_str() );
-  state->errorInfo->msg = state->stringAtor.fromArray( message.c_str() );
+  state->errorInfo.error = true;
+  state->errorInfo.func = state->stringAtor.fromArray( func.c_str() );
+  state->errorInfo.msg = state->stringAtor.fromArray( message.c_str() );
 }
 
 void __ethrowf( State* state, const std::string& fmt, std::string args... ) {
@@ -54,11 +60,11 @@ void __ethrowf( State* state, const std::string& fmt, std::string args... ) {
 }
 
 void __eclear( State* state ) {
-  state->errorInfo->error = false;
+  state->errorInfo.error = false;
 }
 
 bool __echeck( const State* state ) {
-  return state->errorInfo->error;
+  return state->errorInfo.error;
 }
 
 template<typename T>
@@ -81,8 +87,8 @@ bool __ehandle( State* state ) {
 
   bool guardFrameTouched = unwindStackUntilGuardFrame( state, [&sigs, &state]( CallInfo* frame ) {
     if ( frame->protect ) {
-      const auto& errorInfo = state->errorInfo;
-      const String* msg = new String( errorInfo->msg );
+      const ErrorInfo& errorInfo = state->errorInfo;
+      String* msg = new String( errorInfo.msg );
 
       __eclear( state );
       __return( state, Value( msg ) );
@@ -97,7 +103,7 @@ bool __ehandle( State* state ) {
     return true;
   }
 
-  const ErrorInfo* errorInfo = state->errorInfo.obj;
+  const ErrorInfo* errorInfo = &state->errorInfo;
 
   std::ostringstream oss;
   oss << errorInfo->func << ": " << errorInfo->msg << "\n";
@@ -119,7 +125,7 @@ std::string __getValueType( const Value* val ) {
   using enum ValueKind;
 
   // clang-format off
-    switch (val->type) {
+    switch (val->kind()) {
     case Nil:      return "nil";
     case Int:      return "int";
     case Float:    return "float";
@@ -134,84 +140,214 @@ std::string __getValueType( const Value* val ) {
 }
 
 void* __toPointer( const Value* val ) {
-  switch ( val->type ) {
+  switch ( val->kind() ) {
   case ValueKind::Function:
   case ValueKind::Array:
   case ValueKind::Dict:
   case ValueKind::String:
     // This is technically UB... too bad!
-    return reinterpret_cast<void*>( val->u.str );
+    return reinterpret_cast<void*>( val->asString() );
   default:
     return NULL;
   }
 }
 
 void __pushCallInfo( State* state, CallInfo&& ci ) {
-  if ( state->stackTop - state->stack.data >= 200 ) {
+  if ( (size_t)( state->callInfoTop - state->callInfoStack.data ) >= state->callInfoStack.size ) {
     __ethrow( state, "Stack overflow" );
     return;
   }
 
+  // Frames own a reference to their closure, as the value it was called through may be
+  // overwritten while it executes.
+  __retainClosure( ci.closure );
   *( state->callInfoTop++ ) = std::move( ci );
 }
 
 void __popCallInfo( State* state ) {
-  state->callInfoTop--;
+  __releaseClosure( ( --state->callInfoTop )->closure );
 }
 
 template<const bool IsProtected>
-static void callBase( State* state, Closure* closure ) {
+static void callBase( State* state, Closure* closure, uint16_t argBase ) {
   CallInfo cf;
   cf.protect = IsProtected;
-  cf.closure = new Closure( *closure );
+  cf.closure = closure;
+  cf.regBase = state->regBase;
+  cf.regTop = state->regTop;
 
   if ( closure->callee.type == CallableKind::Function ) {
+    const Function& fn = closure->callee.u.fn;
+
+    // The callee window starts at the first argument register, so that arguments are passed in
+    // place. Calls without register arguments place it right after the caller window.
+    Value* base = argBase == OPERAND_INVALID ? state->regTop : state->regBase + argBase;
+    if XVM_UNLIKELY ( base + fn.regCount > state->registers.data + state->registers.size ) {
+      __ethrow( state, "Register overflow" );
+      return;
+    }
+
     // Functions are automatically positioned by RET instructions; no need to increment saved
     // program counter.
     cf.pc = state->pc;
     cf.stackTop = state->stackTop;
 
     __pushCallInfo( state, std::move( cf ) );
+    if XVM_UNLIKELY ( __echeck( state ) ) {
+      return;
+    }
 
-    state->pc = closure->callee.u.fn.code;
+    state->pc = fn.code;
     state->stackBase = state->stackTop;
+    state->regBase = base;
+    state->regTop = base + fn.regCount;
   }
   else if ( closure->callee.type == CallableKind::Native ) {
     // Native functions require manual positioning as they don't increment program counter with
-    // a RET instruction or similar.
+    // a RET instruction or similar. They run in the window of their caller.
     cf.pc = state->pc + 1;
     cf.stackTop = state->stackTop;
 
     __pushCallInfo( state, std::move( cf ) );
-    __return( state, closure->callee.u.ntv( state ) );
+    if XVM_UNLIKELY ( __echeck( state ) ) {
+      return;
+    }
+
+    Value retv = closure->callee.u.ntv( state );
+
+    // Leave the frame of a failed native call on the stack, so that it is unwound (and reported)
+    // by __ehandle like any other frame.
+    if XVM_UNLIKELY ( __echeck( state ) ) {
+      return;
+    }
+
+    __return( state, std::move( retv ) );
   }
 }
 
-void __call( State* state, Closure* closure ) {
-  callBase<false>( state, closure );
+void __call( State* state, Closure* closure, uint16_t argBase ) {
+  callBase<false>( state, closure, argBase );
+}
+
+void __pcall( State* state, Closure* closure, uint16_t argBase ) {
+  callBase<true>( state, closure, argBase );
 }
 
-void __pcall( State* state, Closure* closure ) {
-  callBase<true>( state, closure );
+// Calls a closure in place of the current function, reusing its frame. The callee returns directly
+// to the caller of the current function, so chains of tail calls run in constant stack space.
+//
+// Register arguments are moved to the bottom of the current window. Stack arguments, the top
+// `arity` values, are moved right above the stack top saved in the frame, which is where the frame
+// starts for every callee in the chain. The rest of the registers and stack values of the current
+// function are released, as the callee never sees them. Native callees leave arguments where they
+// are, as with a regular call, and return immediately.
+void __tailcall( State* state, Closure* closure, uint16_t argBase ) {
+  CallInfo* ci = state->callInfoTop - 1;
+  Closure* current = ci->closure;
+
+  // Retain the callee first; moving arguments may overwrite the value it was called through.
+  __closeClosureUpvs( state, current );
+  ci->closure = __retainClosure( closure );
+  __releaseClosure( current );
+
+  if ( closure->callee.type == CallableKind::Native ) {
+    Value retv = closure->callee.u.ntv( state );
+    if XVM_UNLIKELY ( __echeck( state ) ) {
+      return;
+    }
+
+    __return( state, std::move( retv ) );
+    return;
+  }
+
+  const Function& fn = closure->callee.u.fn;
+  const size_t arity = closure->callee.arity;
+
+  if ( state->regBase + fn.regCount > state->registers.data + state->registers.size ) {
+    __ethrow( state, "Register overflow" );
+    return;
+  }
+
+  Value* regs = state->regBase;
+
+  if ( argBase != OPERAND_INVALID ) {
+    for ( size_t i = 0; i < arity; i++ ) {
+      state->regBase[i] = std::move( state->regBase[argBase + i] );
+    }
+
+    regs += arity;
+    state->stackBase = ci->stackTop;
+  }
+  else {
+    Value* args = state->stackTop - arity;
+    for ( size_t i = 0; i < arity; i++ ) {
+      ci->stackTop[i] = std::move( args[i] );
+    }
+
+    state->stackBase = ci->stackTop + arity;
+  }
+
+  for ( Value* reg = regs; reg < state->regTop; reg++ ) {
+    __resetValue( reg );
+  }
+
+  for ( Value* slot = state->stackBase; slot < state->stackTop; slot++ ) {
+    __resetValue( slot );
+  }
+
+  state->stackTop = state->stackBase;
+  state->regTop = state->regBase + fn.regCount;
+  state->pc = fn.code;
 }
 
 void __return( State* XVM_RESTRICT state, Value&& retv ) {
   state->pc = ( state->callInfoTop - 1 )->pc;
   state->stackTop = ( state->callInfoTop - 1 )->stackTop + 1;
+  state->regBase = ( state->callInfoTop - 1 )->regBase;
+  state->regTop = ( state->callInfoTop - 1 )->regTop;
 
   __pushStack( state, std::move( retv ) );
   __popCallInfo( state );
 }
 
-int __getValueLength( const Value* val ) {
+// Returns the size of the register window of a function, one past its highest register operand.
+// Bodies of nested closures are skipped, as they run in windows of their own.
+size_t __getRegisterCount( const Instruction* code, size_t size ) {
+  size_t count = 0;
+
+  for ( size_t i = 0; i < size; i++ ) {
+    const Instruction& insn = code[i];
+    const uint8_t operands = getRegisterOperands( insn.op );
+    const uint16_t regs[] = { insn.a, insn.b, insn.c };
+
+    for ( size_t j = 0; j < 3; j++ ) {
+      if ( ( operands & ( 1 << j ) ) && regs[j] != OPERAND_INVALID ) {
+        count = std::max<size_t>( count, regs[j] + 1 );
+      }
+    }
+
+    // NEXTDICT also writes the key of the entry right above its destination.
+    if ( insn.op == Opcode::NEXTDICT ) {
+      count = std::max<size_t>( count, insn.a + 2 );
+    }
+
+    if ( insn.op == Opcode::CLOSURE ) {
+      i += insn.b;
+    }
+  }
+
+  return count;
+}
+
+Integer __getValueLength( const Value* val ) {
   using enum ValueKind;
 
-  if ( val->type == String )
-    return (int)val->u.str->size;
-  else if ( val->type == Array )
-    return (int)__getArraySize( val->u.arr );
-  else if ( val->type == Dict )
-    return (int)__getDictSize( val->u.dict );
+  if ( val->kind() == String )
+    return (Integer)val->asString()->size;
+  else if ( val->kind() == Array )
+    return (Integer)__getArraySize( val->asArray() );
+  else if ( val->kind() == Dict )
+    return (Integer)__getDictSize( val->asDict() );
 
   return -1;
 }
@@ -219,17 +355,17 @@ int __getValueLength( const Value* val ) {
 std::string __toString( const Value* val ) {
   using enum ValueKind;
 
-  if ( val->type == String ) {
-    return val->u.str->data;
+  if ( val->kind() == String ) {
+    return val->asString()->data;
   }
 
-  switch ( val->type ) {
+  switch ( val->kind() ) {
   case Int:
-    return std::to_string( val->u.i );
+    return std::to_string( val->asInt() );
   case Float:
-    return std::to_string( val->u.f );
+    return std::to_string( val->asFloat() );
   case Bool:
-    return val->u.b ? "true" : "false";
+    return val->asBool() ? "true" : "false";
   case Array:
   case Dict:
     return std::format( "<{}@0x{:x}>", __getValueType( val ), (uintptr_t)__toPointer( val ) );
@@ -237,12 +373,12 @@ std::string __toString( const Value* val ) {
     std::string type = "native";
     std::string id = "";
 
-    if ( val->u.clsr->callee.type == CallableKind::Function ) {
+    if ( val->asClosure()->callee.type == CallableKind::Function ) {
       type = "function ";
-      id = val->u.clsr->callee.u.fn.id;
+      id = val->asClosure()->callee.u.fn.id;
     }
 
-    return std::format( "<{}{}@0x{:x}>", type, id, (uintptr_t)val->u.clsr );
+    return std::format( "<{}{}@0x{:x}>", type, id, (uintptr_t)val->asClosure() );
   }
   default:
     return "nil";
@@ -252,32 +388,32 @@ std::string __toString( const Value* val ) {
 }
 
 bool __toBool( const Value* val ) {
-  if ( val->type == ValueKind::Bool ) {
-    return val->u.b;
+  if ( val->kind() == ValueKind::Bool ) {
+    return val->asBool();
   }
 
-  return val->type != ValueKind::Nil;
+  return val->kind() != ValueKind::Nil;
 }
 
-int __toInt( const Value* val, bool* fail ) {
+Integer __toInt( const Value* val, bool* fail ) {
   using enum ValueKind;
 
   if ( fail != NULL ) {
     *fail = false;
   }
 
-  if ( val->type == Int ) {
-    return val->u.i;
+  if ( val->kind() == Int ) {
+    return val->asInt();
   }
 
-  switch ( val->type ) {
+  switch ( val->kind() ) {
   case String: {
-    const std::string& str = val->u.str->data;
+    const std::string& str = val->asString()->data;
     if ( str.empty() ) {
       break;
     }
 
-    int int_result;
+    Integer int_result;
     auto [ptr, ec] = std::from_chars( str.data(), str.data() + str.size(), int_result );
     if ( ec == std::errc() && ptr == str.data() + str.size() ) {
       return int_result;
@@ -286,7 +422,7 @@ int __toInt( const Value* val, bool* fail ) {
     break;
   }
   case Bool:
-    return (int)val->u.b;
+    return (Integer)val->asBool();
   default:
     break;
   }
@@ -296,25 +432,25 @@ int __toInt( const Value* val, bool* fail ) {
   return -0x0FFFFFFF;
 }
 
-float __toFloat( const Value* val, bool* fail ) {
+Real __toFloat( const Value* val, bool* fail ) {
   using enum ValueKind;
 
   if ( fail != NULL ) {
     *fail = false;
   }
 
-  if ( val->type == Float ) {
-    return val->u.f;
+  if ( val->kind() == Float ) {
+    return val->asFloat();
   }
 
-  switch ( val->type ) {
+  switch ( val->kind() ) {
   case String: {
-    const std::string& str = val->u.str->data;
+    const std::string& str = val->asString()->data;
     if ( str.empty() ) {
       break;
     }
 
-    float float_result;
+    Real float_result;
     auto [ptr_f, ec_f] = std::from_chars( str.data(), str.data() + str.size(), float_result );
     if ( ec_f == std::errc() && ptr_f == str.data() + str.size() ) {
       return float_result;
@@ -323,7 +459,7 @@ float __toFloat( const Value* val, bool* fail ) {
     break;
   }
   case Bool:
-    return (float)val->u.b;
+    return (Real)val->asBool();
   default:
     break;
   }
@@ -336,21 +472,21 @@ float __toFloat( const Value* val, bool* fail ) {
 bool __compareValue( const Value* val0, const Value* val1 ) {
   using enum ValueKind;
 
-  if ( val0->type != val1->type ) {
+  if ( val0->kind() != val1->kind() ) {
     return false;
   }
 
-  switch ( val0->type ) {
+  switch ( val0->kind() ) {
   case Int:
-    return val0->u.i == val1->u.i;
+    return val0->asInt() == val1->asInt();
   case Float:
-    return val0->u.f == val1->u.f;
+    return val0->asFloat() == val1->asFloat();
   case Bool:
-    return val0->u.b == val1->u.b;
+    return val0->asBool() == val1->asBool();
   case Nil:
     return true;
   case String:
-    return !std::strcmp( val0->u.str->data, val1->u.str->data );
+    return __compareString( val0->asString(), val1->asString() );
   default:
     return false;
   }
@@ -361,31 +497,31 @@ bool __compareValue( const Value* val0, const Value* val1 ) {
 bool __deepCompareValue( const Value* val0, const Value* val1 ) {
   using enum ValueKind;
 
-  if ( val0->type != val1->type ) {
+  if ( val0->kind() != val1->kind() ) {
     return false;
   }
 
-  switch ( val0->type ) {
+  switch ( val0->kind() ) {
   case Int:
-    return val0->u.i == val1->u.i;
+    return val0->asInt() == val1->asInt();
   case Float:
-    return val0->u.f == val1->u.f;
+    return val0->asFloat() == val1->asFloat();
   case Bool:
-    return val0->u.b == val1->u.b;
+    return val0->asBool() == val1->asBool();
   case Nil:
     return true;
   case String:
-    return !std::strcmp( val0->u.str->data, val1->u.str->data );
+    return __compareString( val0->asString(), val1->asString() );
   case Array: {
-    if ( __getArraySize( val0->u.arr ) != __getArraySize( val1->u.arr ) ) {
+    if ( __getArraySize( val0->asArray() ) != __getArraySize( val1->asArray() ) ) {
       return false;
     }
 
-    for ( size_t i = 0; i < __getArraySize( val0->u.arr ); i++ ) {
-      Value* val = __getArrayField( val0->u.arr, i );
-      Value* other = __getArrayField( val1->u.arr, i );
+    for ( size_t i = 0; i < __getArraySize( val0->asArray() ); i++ ) {
+      Value val = __getArrayField( val0->asArray(), i );
+      Value other = __getArrayField( val1->asArray(), i );
 
-      if ( !__deepCompareValue( val, other ) ) {
+      if ( !__deepCompareValue( &val, &other ) ) {
         return false;
       }
     }
@@ -401,19 +537,53 @@ bool __deepCompareValue( const Value* val0, const Value* val1 ) {
   return false;
 }
 
+// Acquires a reference to a heap object; returns the object for convenience.
+template<typename T>
+static T* __retainObject( T* obj ) {
+  obj->refCount++;
+  return obj;
+}
+
+// Releases a reference to a heap object, freeing it if it was the last one. Gray objects are still
+// pointed to by the gray stack of the collector, which frees them instead.
+template<typename T>
+static void __releaseObject( T* obj ) {
+  if ( --obj->refCount == 0 && obj->gcColor != GcColor::Gray ) {
+    delete obj;
+  }
+}
+
+// Returns the object held by a value for mutation. An object shared with other values is first
+// replaced by a private copy, so that the mutation is not observed through them. Copies of
+// containers are tracked by the collector of the given state.
+template<typename T>
+static T* __ownObject( State* state, Value* val, T* obj ) {
+  if ( obj->refCount > 1 ) {
+    obj = new T( *obj );
+    if ( state != NULL ) {
+      gcTrack( state, obj, val->kind() );
+    }
+
+    *val = Value( obj );
+  }
+
+  return obj;
+}
+
+// Values share heap objects instead of copying them; mutations go through __own* to copy on write.
 Value __cloneValue( const Value* val ) {
   using enum ValueKind;
 
   // clang-format off
-    switch (val->type) {
+    switch (val->kind()) {
     case Nil:       return Value();
-    case Int:       return Value(val->u.i);
-    case Float:     return Value(val->u.f);
-    case Bool:      return Value(val->u.b);
-    case String:    return Value(new struct String(*val->u.str));
-    case Array:     return Value(new struct Array(*val->u.arr));
-    case Dict:      return Value(new struct Dict(*val->u.dict));
-    case Function:  return Value(new struct Closure(*val->u.clsr));
+    case Int:       return Value(val->asInt());
+    case Float:     return Value(val->asFloat());
+    case Bool:      return Value(val->asBool());
+    case String:    return Value(__retainObject(val->asString()));
+    case Array:     return Value(__retainObject(val->asArray()));
+    case Dict:      return Value(__retainObject(val->asDict()));
+    case Function:  return Value(__retainClosure(val->asClosure()));
     } // clang-format on
 
   XVM_UNREACHABLE();
@@ -423,18 +593,50 @@ void __resetValue( Value* val ) {
   using enum ValueKind;
 
   // clang-format off
-    switch (val->type) {
+    switch (val->kind()) {
     case Nil:
     case Int:
     case Float:
-    case Bool:      val->u = {}; break;
-    case String:    delete val->u.str; break;
-    case Array:     delete val->u.arr; break;
-    case Dict:      delete val->u.dict; break;
-    case Function:  delete val->u.clsr; break;
+    case Bool:      break;
+    case String:    __releaseObject(val->asString()); break;
+    case Array:     __releaseObject(val->asArray()); break;
+    case Dict:      __releaseObject(val->asDict()); break;
+    case Function:  __releaseClosure(val->asClosure()); break;
     } // clang-format on
 
-  val->type = Nil;
+  val->setNil();
+}
+
+String* __ownString( Value* val ) {
+  return __ownObject( NULL, val, val->asString() );
+}
+
+Array* __ownArray( State* state, Value* val ) {
+  return __ownObject( state, val, val->asArray() );
+}
+
+Dict* __ownDict( State* state, Value* val ) {
+  return __ownObject( state, val, val->asDict() );
+}
+
+// Acquires a reference to a string; returns the string for convenience.
+String* __retainString( String* str ) {
+  return __retainObject( str );
+}
+
+// Releases a reference to a string, freeing it if it was the last one.
+void __releaseString( String* str ) {
+  __releaseObject( str );
+}
+
+// Acquires a reference to a closure; returns the closure for convenience.
+Closure* __retainClosure( Closure* closure ) {
+  return __retainObject( closure );
+}
+
+// Releases a reference to a closure, freeing it if it was the last one.
+void __releaseClosure( Closure* closure ) {
+  __releaseObject( closure );
 }
 
 // Checks if a given index is within the bounds of the UpValue vector of the closure.
@@ -454,9 +656,11 @@ UpValue* __getClosureUpv( Closure* closure, size_t upv_id ) {
 }
 
 // Dynamically reassigns UpValue at index <upv_id> the value <val>.
-void __setClosureUpv( Closure* closure, size_t upv_id, Value* val ) {
+void __setClosureUpv( State* state, Closure* closure, size_t upv_id, Value* val ) {
   UpValue* upv = __getClosureUpv( closure, upv_id );
   if ( upv != NULL ) {
+    gcBarrier( state, val );
+
     if ( upv->value != NULL )
       *upv->value = __cloneValue( val );
     else
@@ -479,6 +683,7 @@ static void handleCapture( State* state, Closure* closure, size_t* upvalues ) {
   else { // Upvalue is captured twice; automatically close it.
     UpValue* upv = &( state->callInfoTop - 1 )->closure->upvs.data[idx];
     if ( upv->valid && upv->open ) {
+      gcBarrier( state, upv->value );
       upv->heap = __cloneValue( upv->value );
       upv->value = &upv->heap;
       upv->open = false;
@@ -505,136 +710,422 @@ void __initClosure( State* state, Closure* closure, size_t len ) {
   }
 }
 
-static void closeUpvalue( UpValue* upv ) {
+static void closeUpvalue( State* state, UpValue* upv ) {
+  gcBarrier( state, upv->value );
   upv->heap = __cloneValue( upv->value );
   upv->value = &upv->heap;
   upv->open = false;
 }
 
 // Moves upvalues of the current closure into the heap, "closing" them.
-void __closeClosureUpvs( const Closure* closure ) {
+void __closeClosureUpvs( State* state, const Closure* closure ) {
   for ( UpValue* upv = closure->upvs.data; upv < closure->upvs.data + closure->upvs.size; upv++ ) {
     if ( upv->valid && upv->open ) {
-      closeUpvalue( upv );
+      closeUpvalue( state, upv );
     }
   }
 }
 
-// Hashes a dictionary key using the FNV-1a hashing algorithm.
-size_t __hashDictKey( const Dict* dict, const char* key ) {
-  size_t hash = 2166136261u;
-  while ( *key ) {
-    hash = ( hash ^ *key++ ) * 16777619;
+// Spreads the cached hash of a key over 64 bits. The high half picks the first group to probe and
+// the low bits the control byte, so keys that share a group rarely share a control byte.
+static uint64_t mixDictHash( const String* key ) {
+  return (uint64_t)key->hash * 0x9E3779B97F4A7C15ull;
+}
+
+static int8_t dictCtrlByte( uint64_t mixed ) {
+  return (int8_t)( ( mixed >> 25 ) & 0x7F );
+}
+
+// Returns a mask of the slots of a group whose control byte is the given one.
+static uint32_t matchDictGroup( const int8_t* group, int8_t byte ) {
+#if XVM_SSE2
+  __m128i ctrl = _mm_loadu_si128( reinterpret_cast<const __m128i*>( group ) );
+  return _mm_movemask_epi8( _mm_cmpeq_epi8( ctrl, _mm_set1_epi8( byte ) ) );
+#else
+  uint32_t mask = 0;
+  for ( size_t i = 0; i < kDictGroup; i++ ) {
+    mask |= (uint32_t)( group[i] == byte ) << i;
   }
 
-  return hash % dict->cap;
+  return mask;
+#endif
 }
 
-// Inserts a key-value pair into the hash table component of a given table_obj object.
-void __setDictField( Dict* dict, const char* key, Value val ) {
-  size_t index = __hashDictKey( dict, key );
-  if ( index > dict->cap ) {
-    // Handle relocation
+// Returns a mask of the empty and deleted slots of a group, whose control bytes are negative.
+static uint32_t matchDictFree( const int8_t* group ) {
+#if XVM_SSE2
+  return _mm_movemask_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( group ) ) );
+#else
+  uint32_t mask = 0;
+  for ( size_t i = 0; i < kDictGroup; i++ ) {
+    mask |= (uint32_t)( group[i] < 0 ) << i;
   }
 
-  Dict::HNode& node = dict->data[index];
-  node.key = key;
-  node.value = std::move( val );
-  dict->cvalid = false;
+  return mask;
+#endif
+}
+
+// Returns the first slot of the first group a key is probed in.
+size_t __hashDictKey( const Dict* dict, const String* key ) {
+  return ( ( mixDictHash( key ) >> 32 ) * kDictGroup ) & ( dict->cap - 1 );
 }
 
-// Performs a look-up on the given table with a given key. Returns NULL upon lookup failure.
-Value* __getDictField( const Dict* dict, const char* key ) {
-  size_t index = __hashDictKey( dict, key );
-  if ( index > dict->cap ) {
+// Probes for the slot holding the given key, or returns NULL if the key is absent. Groups are
+// probed with growing strides, which visits every group of a power of two sized table. A key is
+// never inserted past a group with an empty slot, so probing stops at the first one.
+static Dict::HNode* findDictSlot( const Dict* dict, const String* key ) {
+  int8_t byte = dictCtrlByte( mixDictHash( key ) );
+  size_t pos = __hashDictKey( dict, key );
+
+  for ( size_t stride = kDictGroup;; stride += kDictGroup ) {
+    const int8_t* group = dict->ctrl + pos;
+    for ( uint32_t match = matchDictGroup( group, byte ); match != 0; match &= match - 1 ) {
+      Dict::HNode* node = &dict->data[pos + std::countr_zero( match )];
+      if ( node->key == key ) {
+        return node;
+      }
+    }
+
+    if ( matchDictGroup( group, kDictEmpty ) != 0 ) {
+      return NULL;
+    }
+
+    pos = ( pos + stride ) & ( dict->cap - 1 );
+  }
+}
+
+// Returns the index of the first empty or deleted slot on the probe sequence of a key. The load
+// factor guarantees there is one.
+static size_t findDictFree( const Dict* dict, const String* key ) {
+  size_t pos = __hashDictKey( dict, key );
+
+  for ( size_t stride = kDictGroup;; stride += kDictGroup ) {
+    uint32_t match = matchDictFree( dict->ctrl + pos );
+    if ( match != 0 ) {
+      return pos + std::countr_zero( match );
+    }
+
+    pos = ( pos + stride ) & ( dict->cap - 1 );
+  }
+}
+
+// Rehashes the table into new storage, dropping deleted markers. The capacity doubles, unless less
+// than half of the slots hold a key, in which case the table was mostly filled by deleted markers
+// and keeps its capacity.
+void __resizeDict( Dict* dict ) {
+  Dict::HNode* oldData = dict->data;
+  int8_t* oldCtrl = dict->ctrl;
+  size_t oldCap = dict->cap;
+
+  dict->cap = dict->used * 2 < oldCap ? oldCap : oldCap * 2;
+  dict->data = new Dict::HNode[dict->cap];
+  dict->ctrl = new int8_t[dict->cap];
+  dict->deleted = 0;
+  std::memset( dict->ctrl, kDictEmpty, dict->cap );
+
+  for ( size_t i = 0; i < oldCap; i++ ) {
+    if ( oldCtrl[i] >= 0 ) {
+      Dict::HNode& src = oldData[i];
+      size_t index = findDictFree( dict, src.key );
+
+      dict->ctrl[index] = oldCtrl[i];
+      dict->data[index].key = src.key;
+      dict->data[index].value = std::move( src.value );
+    }
+  }
+
+  delete[] oldData;
+  delete[] oldCtrl;
+}
+
+// Inserts a key-value pair into the hash table, or removes the key if the value is nil. The table
+// is rehashed once seven eighths of its slots hold a key or a deleted marker. Returns the slot
+// holding the key, or NULL if it was removed.
+static Dict::HNode* setDictSlot( Dict* dict, String* key, Value&& val ) {
+  if ( val.kind() == ValueKind::Nil ) {
+    __removeDictField( dict, key );
     return NULL;
   }
 
-  return &dict->data[index].value;
+  Dict::HNode* node = findDictSlot( dict, key );
+  if ( node != NULL ) {
+    node->value = std::move( val );
+    return node;
+  }
+
+  if ( ( dict->used + dict->deleted + 1 ) * 8 > dict->cap * 7 ) {
+    __resizeDict( dict );
+  }
+
+  size_t index = findDictFree( dict, key );
+  if ( dict->ctrl[index] == kDictDeleted ) {
+    dict->deleted--;
+  }
+
+  dict->ctrl[index] = dictCtrlByte( mixDictHash( key ) );
+  dict->data[index].key = __retainString( key );
+  dict->data[index].value = std::move( val );
+  dict->used++;
+
+  return &dict->data[index];
 }
 
-// Returns the real size_t of the hashtable component of the given table object.
-size_t __getDictSize( Dict* dict ) {
-  if ( dict->cvalid ) {
-    return dict->csize;
+// Sets a field of the hash table; the key must be interned.
+void __setDictField( Dict* dict, String* key, Value val ) {
+  setDictSlot( dict, key, std::move( val ) );
+}
+
+// Sets a field through the inline cache of the accessing instruction, which holds the slot the
+// key was last found at; see __getDictFieldCached().
+void __setDictFieldCached( Dict* dict, String* key, Value val, uint32_t* slot ) {
+  if ( val.kind() != ValueKind::Nil && *slot < dict->cap && dict->data[*slot].key == key ) {
+    dict->data[*slot].value = std::move( val );
+    return;
   }
 
-  size_t index = 0;
-  for ( ; index < dict->cap; index++ ) {
-    Dict::HNode& obj = dict->data[index];
-    if ( obj.value.type == ValueKind::Nil ) {
-      break;
-    }
+  Dict::HNode* node = setDictSlot( dict, key, std::move( val ) );
+  if ( node != NULL ) {
+    *slot = (uint32_t)( node - dict->data );
+  }
+}
+
+// Removes a key from the hash table, leaving a deleted marker so that probing continues past its
+// slot. Does nothing if the key is absent.
+void __removeDictField( Dict* dict, const String* key ) {
+  Dict::HNode* node = findDictSlot( dict, key );
+  if ( node == NULL ) {
+    return;
   }
 
-  dict->csize = index;
-  dict->cvalid = true;
+  dict->ctrl[node - dict->data] = kDictDeleted;
+  dict->used--;
+  dict->deleted++;
+
+  __releaseString( node->key );
+  node->key = NULL;
+  __resetValue( &node->value );
+}
+
+// Performs a look-up on the given table with a given key, which must be interned. Returns NULL
+// upon lookup failure.
+Value* __getDictField( const Dict* dict, const String* key ) {
+  Dict::HNode* node = findDictSlot( dict, key );
+  return node != NULL ? &node->value : NULL;
+}
+
+// Looks up a field through the inline cache of the accessing instruction, which holds the slot the
+// key was last found at. A slot is identified by the interned key it holds, so the cached slot is
+// checked by comparing a single pointer, and stays valid for every dictionary that holds the key
+// there. Dictionaries used as records get their keys inserted in the same order, which places
+// them in the same slots, so an access site sees the same layout across all of its records and
+// reads them with an indexed load. The cache is updated on a miss.
+Value* __getDictFieldCached( const Dict* dict, const String* key, uint32_t* slot ) {
+  if ( XVM_LIKELY( *slot < dict->cap && dict->data[*slot].key == key ) ) {
+    return &dict->data[*slot].value;
+  }
+
+  Dict::HNode* node = findDictSlot( dict, key );
+  if ( node == NULL ) {
+    return NULL;
+  }
+
+  *slot = (uint32_t)( node - dict->data );
+  return &node->value;
+}
+
+// Returns the interned key of a constant, or NULL if the index is past the constants or the
+// constant is not a string.
+String* __getConstantKey( const State* state, size_t index ) {
+  return index < state->constantKeys.size() ? state->constantKeys[index] : NULL;
+}
+
+// Looks up a field by a key that may not be interned. Keys held in registers are mostly constants,
+// which are interned when the state is created, so their canonical string is only looked up when
+// they are not canonical already; a key without one is absent from every dictionary.
+Value*
+__getDictFieldByKey( const State* state, const Dict* dict, const String* key, uint32_t* slot ) {
+  const String* canonical = key->table == &state->strings ? key : __findString( state, key );
+  return canonical != NULL ? __getDictFieldCached( dict, canonical, slot ) : NULL;
+}
+
+// Sets a field by a key that may not be interned, interning it if needed.
+void __setDictFieldByKey( State* state, Dict* dict, String* key, Value val, uint32_t* slot ) {
+  String* canonical = key->table == &state->strings ? key : __internString( state, key );
+  __setDictFieldCached( dict, canonical, std::move( val ), slot );
+}
+
+// Returns the index of the first slot from the given one that holds a key, or the capacity of the
+// table if there is none.
+size_t __nextDictSlot( const Dict* dict, size_t index ) {
+  while ( index < dict->cap && dict->ctrl[index] < 0 ) {
+    index++;
+  }
 
   return index;
 }
 
-// Checks if the given index is out of bounds of a given tables array component.
+// Returns the key held in an occupied slot of the table, as a new reference.
+Value __getDictSlotKey( const Dict* dict, size_t index ) {
+  return Value( __retainObject( dict->data[index].key ) );
+}
+
+// Returns the number of keys in the hash table.
+size_t __getDictSize( const Dict* dict ) {
+  return dict->used;
+}
+
+// Checks if the given index is within the elements of an array.
 bool __rangeCheckArray( const Array* array, size_t index ) {
-  return array->cap > index;
+  return array->size > index;
 }
 
-// Dynamically grows and relocates the array component of a given table_obj object.
-void __resizeArray( Array* array ) {
-  size_t oldcap = array->cap;
-  size_t newcap = oldcap * 2;
+// Checks if an index may address an element of an array, that is if it is neither negative nor
+// past the largest array size.
+bool __checkArrayIndex( Integer index ) {
+  return index >= 0 && (uint64_t)index < kArrayMaxSize;
+}
 
-  Value* old_location = array->data;
-  Value* new_location = new Value[newcap];
+// Grows the buffer of an array to hold at least the given number of elements, which must not
+// exceed kArrayMaxSize. Capacity at least doubles, so a sequence of appends costs amortized
+// constant time per element.
+void __resizeArray( Array* array, size_t mincap ) {
+  array->reserve( std::clamp( array->cap * 2, mincap, kArrayMaxSize ) );
+}
 
-  for ( Value* ptr = old_location; ptr < old_location + oldcap; ptr++ ) {
-    size_t position = ptr - old_location;
-    new_location[position] = std::move( *ptr );
-  }
+// Stores a value into the unboxed buffer of a typed array. Returns false without touching the
+// array if the array is generic or the value does not match its element kind.
+static bool setTypedField( Array* array, size_t index, const Value& val ) {
+  switch ( array->kind ) {
+  case ArrayKind::Int:
+    if ( val.kind() != ValueKind::Int ) {
+      return false;
+    }
 
-  array->data = new_location;
-  array->cap = newcap;
+    array->ints[index] = val.asInt();
+    return true;
+  case ArrayKind::Float:
+    if ( val.kind() != ValueKind::Float ) {
+      return false;
+    }
 
-  delete[] old_location;
+    array->floats[index] = val.asFloat();
+    return true;
+  default:
+    return false;
+  }
 }
 
-// Sets the given index of a table to a given value. Resizes the array component of the table_obj
-// object if necessary.
+// Sets the given index of an array to a given value, extending the array up to the index if
+// necessary. The index must pass __checkArrayIndex. Typed arrays fall back to generic storage when
+// the value does not fit them.
 void __setArrayField( Array* array, size_t index, Value val ) {
-  if ( !__rangeCheckArray( array, index ) ) {
-    __resizeArray( array );
+  if ( index >= array->cap ) {
+    __resizeArray( array, index + 1 );
+  }
+
+  if ( array->kind != ArrayKind::Generic ) {
+    // Typed arrays have no holes, so they can only be extended by their next element.
+    if ( index <= array->size && setTypedField( array, index, val ) ) {
+      array->size = std::max( array->size, index + 1 );
+      return;
+    }
+
+    array->despecialize();
+  }
+
+  if ( index >= array->size ) {
+    array->size = index + 1;
   }
 
-  array->cvalid = false;
   array->data[index] = std::move( val );
 }
 
-// Attempts to get the value at the given index of the array component of the table. Returns NULL
-// if the index is out of array cap range.
-Value* __getArrayField( const Array* array, size_t index ) {
+// Returns the value at the given index of an array, or nil if the index is past the end of the
+// array.
+Value __getArrayField( const Array* array, size_t index ) {
   if ( !__rangeCheckArray( array, index ) ) {
-    return NULL;
+    return XVM_NIL;
   }
 
-  return &array->data[index];
+  switch ( array->kind ) {
+  case ArrayKind::Int:
+    return Value( array->ints[index] );
+  case ArrayKind::Float:
+    return Value( array->floats[index] );
+  default:
+    return __cloneValue( &array->data[index] );
+  }
 }
 
-// Returns the real size_t of the given tables array component.
-size_t __getArraySize( Array* array ) {
-  if ( array->cvalid ) {
-    return array->csize;
+// Appends a value to the end of an array, which must be smaller than kArrayMaxSize.
+void __appendArray( Array* array, Value val ) {
+  if ( array->size == array->cap ) {
+    __resizeArray( array, array->size + 1 );
   }
 
-  size_t size = 0;
-  for ( Value* ptr = array->data; ptr < array->data + array->cap; ptr++ ) {
-    if ( ptr->type != ValueKind::Nil ) {
-      size++;
+  if ( array->kind != ArrayKind::Generic ) {
+    if ( setTypedField( array, array->size, val ) ) {
+      array->size++;
+      return;
     }
+
+    array->despecialize();
   }
 
-  array->csize = size;
-  array->cvalid = true;
+  array->data[array->size++] = std::move( val );
+}
+
+// Removes and returns the last element of an array, or nil if the array is empty.
+Value __popArray( Array* array ) {
+  if ( array->size == 0 ) {
+    return XVM_NIL;
+  }
 
-  return size;
+  switch ( array->kind ) {
+  case ArrayKind::Int:
+    return Value( array->ints[--array->size] );
+  case ArrayKind::Float:
+    return Value( array->floats[--array->size] );
+  default:
+    break;
+  }
+
+  Value val = std::move( array->data[--array->size] );
+  array->data[array->size] = XVM_NIL;
+  return val;
+}
+
+// Returns the index of the first element from the given one that is not nil, or the size of the
+// array if there is none.
+size_t __nextArraySlot( const Array* array, size_t index ) {
+  if ( array->kind != ArrayKind::Generic ) {
+    return index;
+  }
+
+  while ( index < array->size && array->data[index].kind() == ValueKind::Nil ) {
+    index++;
+  }
+
+  return index;
+}
+
+// Returns the slot an iteration cursor points to. Iteration starts at a nil cursor, and the cursor
+// is reset to nil once the container is exhausted; a cursor that is not a slot index is past the
+// end.
+size_t __getIterCursor( const Value* cursor ) {
+  switch ( cursor->kind() ) {
+  case ValueKind::Nil:
+    return 0;
+  case ValueKind::Int:
+    return cursor->asInt() >= 0 ? (size_t)cursor->asInt() : SIZE_MAX;
+  default:
+    return SIZE_MAX;
+  }
+}
+
+// Returns the number of elements in an array.
+size_t __getArraySize( const Array* array ) {
+  return array->size;
 }
 
 char __getString( const String* str, size_t pos, bool* fail ) {
@@ -658,6 +1149,7 @@ void __setString( String* str, size_t pos, char chr, bool* fail ) {
 
   if ( pos < str->size ) {
     str->data[pos] = chr;
+    str->hash = strhash( str->data, str->size );
     return;
   }
 
@@ -667,14 +1159,92 @@ void __setString( String* str, size_t pos, char chr, bool* fail ) {
 }
 
 String* __concatString( String* left, String* right ) {
-  TempBuf<char> buf( left->size + right->size + 1 );
+  // Written in place; the terminator is already set by the constructor
+  String* str = new String( left->size + right->size );
+
+  std::memcpy( str->data, left->data, left->size );
+  std::memcpy( str->data + left->size, right->data, right->size );
+  str->hash = strhash( str->data, str->size );
+
+  return str;
+}
+
+// Appends a string in place. Storage grows geometrically and the hash is extended over the
+// appended bytes only, so building a string by repeated appends takes linear time.
+void __appendString( String* str, const String* other ) {
+  size_t size = str->size + other->size;
+  if ( size > str->cap ) {
+    str->reserve( std::max( size, str->cap * 2 ) );
+  }
 
-  std::memcpy( buf.data, left->data, left->size );
-  std::memcpy( buf.data + left->size, right->data, right->size );
-  // Set nullbyte
-  std::memset( buf.data + left->size + right->size, 0, 1 );
+  // Read through other after growing, as it may be the same string.
+  std::memcpy( str->data + str->size, other->data, other->size );
+  str->data[size] = '\0';
+  str->hash = strhash( str->data + str->size, other->size, str->hash );
+  str->size = size;
+}
+
+// Compares the contents of two strings. Distinct strings interned in the same table never have
+// the same contents, so they are told apart without looking at their data.
+bool __compareString( const String* left, const String* right ) {
+  if ( left == right ) {
+    return true;
+  }
+
+  if ( left->table != NULL && left->table == right->table ) {
+    return false;
+  }
+
+  return left->size == right->size && left->hash == right->hash &&
+    !std::memcmp( left->data, right->data, left->size );
+}
+
+// Returns the canonical string with the same contents as the given one, making the given string
+// canonical if there is none yet.
+String* __internString( State* state, String* str ) {
+  String* canonical = __findString( state, str );
+  if ( canonical == NULL ) {
+    canonical = __retainString( str );
+    canonical->table = &state->strings;
+    state->strings.strings.insert( canonical );
+  }
+
+  return canonical;
+}
+
+// Returns the canonical string with the given contents, creating it if there is none yet.
+String* __internString( State* state, const char* str ) {
+  String* canonical = __findString( state, str );
+  if ( canonical == NULL ) {
+    canonical = new String( str );
+    canonical->table = &state->strings;
+    state->strings.strings.insert( canonical );
+  }
 
-  return new String( buf.data );
+  return canonical;
+}
+
+// Returns the canonical string with the same contents as the given one, or NULL if there is none.
+String* __findString( const State* state, const String* str ) {
+  if ( str->table == &state->strings ) {
+    return const_cast<String*>( str );
+  }
+
+  StringTable::Key key{ str->data, str->size, str->hash };
+
+  auto it = state->strings.strings.find( key );
+  return it != state->strings.strings.end() ? *it : NULL;
+}
+
+// Returns the canonical string with the given contents, or NULL if there is none.
+String* __findString( const State* state, const char* str ) {
+  size_t size;
+  uint32_t hash = strhashlen( str, &size );
+
+  StringTable::Key key{ str, size, hash };
+
+  auto it = state->strings.strings.find( key );
+  return it != state->strings.strings.end() ? *it : NULL;
 }
 
 void __pushStack( State* state, Value&& val ) {
@@ -686,16 +1256,36 @@ void __dropStack( State* state ) {
   __resetValue( state->stackTop );
 }
 
+// Globals are looked up by canonical name; a name that was never interned cannot be a key.
+Value* __getGlobal( State* state, const String* name ) {
+  const String* key = __findString( state, name );
+  return key != NULL ? __getDictField( state->globalEnv, key ) : NULL;
+}
+
 Value* __getGlobal( State* state, const char* name ) {
-  return __getDictField( state->globalEnv, name );
+  const String* key = __findString( state, name );
+  return key != NULL ? __getDictField( state->globalEnv, key ) : NULL;
 }
 
 const Value* __getGlobal( const State* state, const char* name ) {
-  return __getDictField( state->globalEnv, name );
+  const String* key = __findString( state, name );
+  return key != NULL ? __getDictField( state->globalEnv, key ) : NULL;
+}
+
+void __setGlobal( State* state, String* name, Value&& val ) {
+  __setDictField( state->globalEnv, __internString( state, name ), std::move( val ) );
+}
+
+Value* __getGlobalCached( State* state, const String* name, uint32_t* slot ) {
+  return __getDictFieldByKey( state, state->globalEnv, name, slot );
+}
+
+void __setGlobalCached( State* state, String* name, Value&& val, uint32_t* slot ) {
+  __setDictFieldByKey( state, state->globalEnv, name, std::move( val ), slot );
 }
 
 void __setGlobal( State* state, const char* name, Value&& val ) {
-  __setDictField( state->globalEnv, name, std::move( val ) );
+  __setDictField( state->globalEnv, __internString( state, name ), std::move( val ) );
 }
 
 Value* __getLocal( State* state, size_t offset ) {
@@ -719,15 +1309,46 @@ void __setLocal( State* XVM_RESTRICT state, size_t offset, Value&& val ) {
 }
 
 void __setRegister( State* state, uint16_t reg, Value&& val ) {
-  state->registers.data[reg] = std::move( val );
+  state->regBase[reg] = std::move( val );
 }
 
 Value* __getRegister( State* state, uint16_t reg ) {
-  return &state->registers.data[reg];
+  return &state->regBase[reg];
 }
 
 const Value* __getRegister( const State* state, uint16_t reg ) {
-  return &state->registers.data[reg];
+  return &state->regBase[reg];
+}
+
+void __profileInstruction( OpcodeProfile* profile, const Instruction* insn ) {
+  const Instruction* prev = profile->last[0];
+  const Instruction* prev2 = profile->last[1];
+
+  // Only count straight-line execution; a sequence interrupted by a jump, call or return can not
+  // be replaced by a superinstruction.
+  if ( prev != NULL && insn == prev + 1 ) {
+    uint32_t pair = ( (uint32_t)prev->op << 16 ) | (uint16_t)insn->op;
+    profile->pairs[pair]++;
+
+    if ( prev2 != NULL && prev == prev2 + 1 ) {
+      uint64_t triple = ( (uint64_t)prev2->op << 32 ) | pair;
+      profile->triples[triple]++;
+    }
+  }
+
+  profile->last[1] = prev;
+  profile->last[0] = insn;
+}
+
+void __dumpOpcodeProfile( const OpcodeProfile* profile, std::ostream& out ) {
+  for ( const auto& [key, count] : profile->pairs ) {
+    out << "pair " << count << ' ' << ( key >> 16 ) << ' ' << ( key & 0xFFFF ) << '\n';
+  }
+
+  for ( const auto& [key, count] : profile->triples ) {
+    out << "triple " << count << ' ' << ( key >> 32 ) << ' ' << ( ( key >> 16 ) & 0xFFFF ) << ' '
+        << ( key & 0xFFFF ) << '\n';
+  }
 }
 
 } // namespace impl
@@ -17,6 +17,7 @@
 #include "xvm_dict.h"
 #include "xvm_array.h"
 #include "xvm_closure.h"
+#include "xvm_profile.h"
 
 /**
  * @namespace xvm
@@ -46,53 +47,87 @@ Value __getConstant( const State* state, size_t index );
 
 void __pushCallInfo( State* state, CallInfo&& ci );
 void __popCallInfo( State* state );
-void __call( State* state, Closure* callee );
-void __pcall( State* state, Closure* callee );
+void __call( State* state, Closure* callee, uint16_t argBase = OPERAND_INVALID );
+void __pcall( State* state, Closure* callee, uint16_t argBase = OPERAND_INVALID );
+void __tailcall( State* state, Closure* callee, uint16_t argBase = OPERAND_INVALID );
 void __return( State* XVM_RESTRICT state, Value&& retv );
+size_t __getRegisterCount( const Instruction* code, size_t size );
 
 void* __toPointer( const Value* val );
 bool __toBool( const Value* val );
-int __toInt( const Value* val, bool* fail = NULL );
-float __toFloat( const Value* val, bool* fail = NULL );
+Integer __toInt( const Value* val, bool* fail = NULL );
+Real __toFloat( const Value* val, bool* fail = NULL );
 std::string __toString( const Value* val );
 std::string __getValueType( const Value* val );
-int __getValueLength( const Value* val );
+Integer __getValueLength( const Value* val );
 bool __compareValue( const Value* val0, const Value* val1 );
 bool __deepCompareValue( const Value* val0, const Value* val1 );
 Value __cloneValue( const Value* val );
 void __resetValue( Value* val );
-
+String* __ownString( Value* val );
+Array* __ownArray( State* state, Value* val );
+Dict* __ownDict( State* state, Value* val );
+
+String* __retainString( String* str );
+void __releaseString( String* str );
+Closure* __retainClosure( Closure* closure );
+void __releaseClosure( Closure* closure );
 void __resizeClosureUpvs( Closure* closure );
 bool __rangeCheckClosureUpvs( Closure* closure, size_t index );
 UpValue* __getClosureUpv( Closure* closure, size_t upv_id );
 void __resizeClosureUpvs( Closure* closure );
 bool __rangeCheckClosureUpvs( Closure* closure, size_t index );
 UpValue* __getClosureUpv( Closure* closure, size_t upv_id );
-void __setClosureUpv( Closure* closure, size_t upv_id, Value* val );
+void __setClosureUpv( State* state, Closure* closure, size_t upv_id, Value* val );
 void __initClosure( State* state, Closure* closure, size_t len );
-void __closeClosureUpvs( const Closure* closure );
+void __closeClosureUpvs( State* state, const Closure* closure );
 
 char __getString( const String* str, size_t pos, bool* fail = NULL );
 void __setString( String* str, size_t pos, char chr, bool* fail = NULL );
 String* __concatString( String* left, String* right );
-
-size_t __hashDictKey( const Dict* dict, const char* key );
-void __setDictField( Dict* dict, const char* key, Value val );
-Value* __getDictField( const Dict* dict, const char* key );
-size_t __getDictSize( Dict* dict );
+void __appendString( String* str, const String* other );
+bool __compareString( const String* left, const String* right );
+String* __internString( State* state, String* str );
+String* __internString( State* state, const char* str );
+String* __findString( const State* state, const String* str );
+String* __findString( const State* state, const char* str );
+
+size_t __hashDictKey( const Dict* dict, const String* key );
+void __resizeDict( Dict* dict );
+void __setDictField( Dict* dict, String* key, Value val );
+void __setDictFieldCached( Dict* dict, String* key, Value val, uint32_t* slot );
+Value* __getDictField( const Dict* dict, const String* key );
+Value* __getDictFieldCached( const Dict* dict, const String* key, uint32_t* slot );
+String* __getConstantKey( const State* state, size_t index );
+Value*
+__getDictFieldByKey( const State* state, const Dict* dict, const String* key, uint32_t* slot );
+void __setDictFieldByKey( State* state, Dict* dict, String* key, Value val, uint32_t* slot );
+size_t __nextDictSlot( const Dict* dict, size_t index );
+Value __getDictSlotKey( const Dict* dict, size_t index );
+void __removeDictField( Dict* dict, const String* key );
+size_t __getDictSize( const Dict* dict );
 
 bool __rangeCheckArray( const Array* array, size_t index );
-void __resizeArray( Array* array );
+bool __checkArrayIndex( Integer index );
+void __resizeArray( Array* array, size_t mincap );
 void __setArrayField( Array* array, size_t index, Value val );
-Value* __getArrayField( const Array* array, size_t index );
-size_t __getArraySize( Array* array );
+Value __getArrayField( const Array* array, size_t index );
+void __appendArray( Array* array, Value val );
+Value __popArray( Array* array );
+size_t __getArraySize( const Array* array );
+size_t __nextArraySlot( const Array* array, size_t index );
+size_t __getIterCursor( const Value* cursor );
 
 void __pushStack( State* state, Value&& val );
 void __dropStack( State* state );
 
+void __setGlobal( State* state, String* name, Value&& val );
 void __setGlobal( State* state, const char* name, Value&& val );
+void __setGlobalCached( State* state, String* name, Value&& val, uint32_t* slot );
+Value* __getGlobal( State* state, const String* name );
 Value* __getGlobal( State* state, const char* name );
 const Value* __getGlobal( const State* state, const char* name );
+Value* __getGlobalCached( State* state, const String* name, uint32_t* slot );
 
 void __setLocal( State* XVM_RESTRICT state, size_t offset, Value&& val );
 Value* __getLocal( State* state, size_t offset );
@@ -105,6 +140,9 @@ void __setRegister( State* state, uint16_t reg, Value&& val );
 Value* __getRegister( State* state, uint16_t reg );
 const Value* __getRegister( const State* state, uint16_t reg );
 
+void __profileInstruction( OpcodeProfile* profile, const Instruction* insn );
+void __dumpOpcodeProfile( const OpcodeProfile* profile, std::ostream& out );
+
 } // namespace impl
 
 /** @} */
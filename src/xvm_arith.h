@@ -0,0 +1,123 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+/**
+ * @file arith.h
+ * @brief Arithmetic helpers shared by the interpreter and the JIT runtime stubs.
+ */
+#ifndef XVM_ARITH_H
+#define XVM_ARITH_H
+
+#include "xvm_common.h"
+#include "xvm_opcode.h"
+#include "xvm_value.h"
+#include <cmath>
+
+namespace xvm {
+
+static inline bool isArithOpcode( Opcode op ) {
+  using enum Opcode;
+
+  return (uint16_t)op >= (uint16_t)ADD && (uint16_t)op <= (uint16_t)FPOW;
+}
+
+template<typename A, typename B = A>
+static inline XVM_FORCEINLINE void performArith( Opcode op, A& a, B b ) {
+  using enum Opcode;
+
+  switch ( op ) {
+  case ADD:
+  case IADD:
+  case FADD:
+    a += b;
+    break;
+  case SUB:
+  case ISUB:
+  case FSUB:
+    a -= b;
+    break;
+  case MUL:
+  case IMUL:
+  case FMUL:
+    a *= b;
+    break;
+  case DIV:
+  case IDIV:
+  case FDIV:
+    a /= b;
+    break;
+  case MOD:
+  case IMOD:
+  case FMOD:
+    a = std::fmod( a, b );
+    break;
+  case POW:
+  case IPOW:
+  case FPOW:
+    a = std::pow( a, b );
+    break;
+  default:
+    break;
+  }
+}
+
+static inline XVM_FORCEINLINE int arith( Opcode op, Value* lhs, Value* rhs ) {
+  using enum ValueKind;
+
+  if ( !isArithOpcode( op ) ) {
+    return 1;
+  }
+
+  if ( lhs->kind() == Int && rhs->kind() == Int ) {
+    Integer a = lhs->asInt();
+    performArith( op, a, rhs->asInt() );
+    lhs->setInt( a );
+  }
+  else {
+    auto as_float = []( const Value& v ) -> Real {
+      return v.kind() == Int ? static_cast<Real>( v.asInt() ) : v.asFloat();
+    };
+
+    Real a = as_float( *lhs );
+    Real b = as_float( *rhs );
+
+    performArith( op, a, b );
+    lhs->setFloat( a );
+  }
+
+  return 0;
+}
+
+static inline XVM_FORCEINLINE void iarith( Opcode op, Value* lhs, Integer i ) {
+  using enum ValueKind;
+
+  if XVM_LIKELY ( lhs->kind() == Int ) {
+    Integer a = lhs->asInt();
+    performArith( op, a, i );
+    lhs->setInt( a );
+  }
+  else if ( lhs->kind() == Float ) {
+    Real a = lhs->asFloat();
+    performArith( op, a, i );
+    lhs->setFloat( a );
+  }
+}
+
+static inline XVM_FORCEINLINE void farith( Opcode op, Value* lhs, Real f ) {
+  using enum ValueKind;
+
+  if XVM_LIKELY ( lhs->kind() == Int ) {
+    Integer a = lhs->asInt();
+    performArith( op, a, f );
+    lhs->setInt( a );
+  }
+  else if ( lhs->kind() == Float ) {
+    Real a = lhs->asFloat();
+    performArith( op, a, f );
+    lhs->setFloat( a );
+  }
+}
+
+} // namespace xvm
+
+#endif
@@ -3,38 +3,94 @@
 
 #include "xvm_array.h"
 #include "xvm_api_impl.h"
+#include <algorithm>
 
 namespace xvm {
 
-Array::Array( const Array& other )
-  : data( new Value[kArrayCapacity] ),
-    cap( other.cap ),
-    csize( other.csize ) {
-  for ( size_t i = 0; i < cap; i++ ) {
-    data[i] = impl::__cloneValue( other.data + i );
+// Allocates the element buffer of an array for its kind and capacity.
+static void allocElements( Array* array ) {
+  switch ( array->kind ) {
+  case ArrayKind::Int:
+    array->ints = new Integer[array->cap];
+    break;
+  case ArrayKind::Float:
+    array->floats = new Real[array->cap];
+    break;
+  default:
+    array->data = new Value[array->cap];
+    break;
+  }
+}
+
+// Frees the element buffer of an array.
+static void freeElements( Array* array ) {
+  switch ( array->kind ) {
+  case ArrayKind::Int:
+    delete[] array->ints;
+    break;
+  case ArrayKind::Float:
+    delete[] array->floats;
+    break;
+  default:
+    delete[] array->data;
+    break;
   }
 }
 
+// Copies the elements of an array into the buffer of another one of the same kind.
+static void copyElements( Array* array, const Array* other ) {
+  switch ( array->kind ) {
+  case ArrayKind::Int:
+    std::copy( other->ints, other->ints + other->size, array->ints );
+    break;
+  case ArrayKind::Float:
+    std::copy( other->floats, other->floats + other->size, array->floats );
+    break;
+  default:
+    for ( size_t i = 0; i < other->size; i++ ) {
+      array->data[i] = impl::__cloneValue( other->data + i );
+    }
+    break;
+  }
+}
+
+// Moves the first `size` elements of a buffer into a new one of the given capacity.
+template<typename T>
+static T* growElements( T* elems, size_t size, size_t cap ) {
+  T* grown = new T[cap];
+  std::move( elems, elems + size, grown );
+
+  delete[] elems;
+  return grown;
+}
+
+Array::Array( const Array& other )
+  : Array( other.cap, other.kind ) {
+  size = other.size;
+  copyElements( this, &other );
+}
+
 Array::Array( Array&& other )
   : data( other.data ),
     cap( other.cap ),
-    csize( other.csize ) {
+    size( other.size ),
+    kind( other.kind ) {
   other.cap = 0;
   other.data = NULL;
-  other.csize = {};
+  other.size = 0;
+  other.kind = ArrayKind::Generic;
 }
 
 Array& Array::operator=( const Array& other ) {
   if ( this != &other ) {
-    delete[] data;
+    freeElements( this );
 
-    data = new Value[cap];
     cap = other.cap;
-    csize = other.csize;
+    size = other.size;
+    kind = other.kind;
 
-    for ( size_t i = 0; i < cap; i++ ) {
-      data[i] = impl::__cloneValue( other.data + i );
-    }
+    allocElements( this );
+    copyElements( this, &other );
   }
 
   return *this;
@@ -42,25 +98,68 @@ Array& Array::operator=( const Array& other ) {
 
 Array& Array::operator=( Array&& other ) {
   if ( this != &other ) {
-    delete[] data;
+    freeElements( this );
 
     data = other.data;
     cap = other.cap;
-    csize = other.csize;
+    size = other.size;
+    kind = other.kind;
 
     other.cap = 0;
-    other.csize = {};
+    other.size = 0;
     other.data = NULL;
+    other.kind = ArrayKind::Generic;
   }
 
   return *this;
 }
 
 Array::Array()
-  : data( new Value[kArrayCapacity] ) {}
+  : Array( kArrayCapacity ) {}
+
+Array::Array( size_t capacity, ArrayKind kind )
+  : cap( capacity ),
+    kind( kind ) {
+  allocElements( this );
+}
 
 Array::~Array() {
-  delete[] data;
+  freeElements( this );
+}
+
+void Array::reserve( size_t cap ) {
+  if ( cap <= this->cap ) {
+    return;
+  }
+
+  switch ( kind ) {
+  case ArrayKind::Int:
+    ints = growElements( ints, size, cap );
+    break;
+  case ArrayKind::Float:
+    floats = growElements( floats, size, cap );
+    break;
+  default:
+    data = growElements( data, size, cap );
+    break;
+  }
+
+  this->cap = cap;
+}
+
+void Array::despecialize() {
+  if ( kind == ArrayKind::Generic ) {
+    return;
+  }
+
+  Value* values = new Value[cap];
+  for ( size_t i = 0; i < size; i++ ) {
+    values[i] = kind == ArrayKind::Int ? Value( ints[i] ) : Value( floats[i] );
+  }
+
+  freeElements( this );
+  data = values;
+  kind = ArrayKind::Generic;
 }
 
 } // namespace xvm
@@ -7,12 +7,14 @@
  *
  * The Array structure implements a dynamic array of `Value`s with automatic resizing
  * and index-based access. Arrays are core collection types in the xvm language runtime.
+ * Arrays of numbers may store their elements unboxed.
  */
 #ifndef XVM_ARRAY_H
 #define XVM_ARRAY_H
 
 #include "xvm_common.h"
 #include "xvm_value.h"
+#include "xvm_gc.h"
 
 /**
  * @namespace xvm
@@ -26,26 +28,55 @@ namespace xvm {
  */
 inline constexpr size_t kArrayCapacity = 64;
 
+/**
+ * @brief Largest number of elements an array can grow to.
+ */
+inline constexpr size_t kArrayMaxSize = (size_t)1 << 28;
+
+/**
+ * @enum ArrayKind
+ * @brief Selects how the elements of an array are stored.
+ */
+enum class ArrayKind : uint8_t {
+  Generic, ///< Boxed `Value` elements of any kind.
+  Int,     ///< Unboxed `Integer` elements.
+  Float,   ///< Unboxed `Real` elements.
+};
+
 /**
  * @struct Array
  * @brief A growable, dynamically sized array of `Value` elements.
- * @see CSize
  *
  * This structure wraps a heap-allocated buffer of `Value` entries and supports
- * index-based access with automatic capacity expansion. Internally, resizing is
- * delegated to the `CSize` helper, which tracks the logical size and performs bounds checks.
+ * index-based access with automatic capacity expansion. The first `size` slots hold the
+ * elements of the array; writing past the end extends it, filling any gap with nil, and
+ * growth at least doubles the capacity so appends are amortized constant time.
+ *
+ * Typed arrays store Int or Float elements unboxed and contiguously, without holes. Storing any
+ * other value, or writing past the end, converts the array to generic storage first.
+ *
+ * Arrays are shared between values and copied on write; copies start with a single reference.
  */
-struct Array {
-  Value* data = NULL;          ///< Pointer to array data buffer.
-  size_t cap = kArrayCapacity; ///< Allocated capacity.
-  size_t csize;
-  bool cvalid;
+struct Array : GcObject {
+  union {
+    Value* data = NULL; ///< Element buffer of a generic array.
+    Integer* ints;      ///< Element buffer of an Int array.
+    Real* floats;       ///< Element buffer of a Float array.
+  };
+
+  size_t cap = kArrayCapacity;         ///< Allocated capacity.
+  size_t size = 0;                     ///< Number of elements.
+  ArrayKind kind = ArrayKind::Generic; ///< Storage of the elements.
 
   XVM_IMPLCOPY( Array );
   XVM_IMPLMOVE( Array );
 
   Array();
+  explicit Array( size_t capacity, ArrayKind kind = ArrayKind::Generic );
   ~Array();
+
+  void reserve( size_t cap ); ///< Grows the buffer to hold at least `cap` elements.
+  void despecialize();        ///< Converts the elements to generic storage.
 };
 
 } // namespace xvm
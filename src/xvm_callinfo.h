@@ -39,6 +39,8 @@ struct CallInfo {
   bool protect = false;    ///< Protect callframe from errors
   Closure* closure = NULL; ///< Function closure being invoked.
   Value* stackTop = NULL;  ///< Stack top when function was called
+  Value* regBase = NULL;   ///< Register window of the caller
+  Value* regTop = NULL;    ///< End of the register window of the caller
 
   const Instruction* pc = NULL; ///< Program counter when function was called
 };
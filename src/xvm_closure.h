@@ -16,6 +16,7 @@
 #include "xvm_instruction.h"
 #include "xvm_allocator.h"
 #include "xvm_value.h"
+#include "xvm_gc.h"
 
 /**
  * @namespace xvm
@@ -52,8 +53,9 @@ struct Function {
   /// Identifier string or default name.
   const char* id = "<anonymous>";
 
-  size_t line = 0; ///< Line number where function was defined (for debugging).
-  size_t size = 0; ///< Total number of instructions.
+  size_t line = 0;     ///< Line number where function was defined (for debugging).
+  size_t size = 0;     ///< Total number of instructions.
+  size_t regCount = 0; ///< Size of the register window of the function.
 
   /// Pointer to the function’s instruction sequence.
   const Instruction* code = NULL;
@@ -97,12 +99,17 @@ struct Callable {
  * @brief Wraps a Callable with its captured upvalues for lexical scoping.
  *
  * A Closure is created when a function expression references non-local variables.
+ *
+ * Closures are shared rather than copied; every value holding a closure and every call frame
+ * executing it owns a reference, and the closure is freed when the last one is released.
  */
-struct Closure {
+struct Closure : GcObject {
   Callable callee;
   TempBuf<UpValue> upvs;
 
   Closure( Callable&& callable, size_t upvCount = 0 );
+
+  XVM_NOCOPY( Closure );
 };
 
 } // namespace xvm
@@ -77,6 +77,7 @@
 #define XVM_FUNCSIG __FUNCSIG__
 #define XVM_LIKELY( x ) ( x ) // No branch prediction hints in MSVC
 #define XVM_UNLIKELY( x ) ( x )
+#define XVM_NOSANITIZE __declspec( no_sanitize_address )
 #else // GCC / Clang
 #define XVM_RESTRICT __restrict__
 #define XVM_NORETURN __attribute__( ( noreturn ) )
@@ -86,6 +87,19 @@
 #define XVM_FUNCSIG __PRETTY_FUNCTION__
 #define XVM_LIKELY( a ) ( __builtin_expect( !!( a ), 1 ) )
 #define XVM_UNLIKELY( a ) ( __builtin_expect( !!( a ), 0 ) )
+#define XVM_NOSANITIZE __attribute__( ( no_sanitize_address ) )
+#endif
+
+/**
+ * @brief Whether string and dictionary kernels process 16 bytes at a time with SSE2. SSE2 is part
+ * of the x86-64 baseline, so it needs no runtime detection; other targets use scalar kernels.
+ */
+#ifndef XVM_SSE2
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#define XVM_SSE2 1
+#else
+#define XVM_SSE2 0
+#endif
 #endif
 
 #define XVM_NOMANGLE extern "C"
@@ -6,39 +6,64 @@
 
 namespace xvm {
 
-Dict::Dict( const Dict& other )
-  : data( new Dict::HNode[kDictCapacity] ),
-    cap( other.cap ),
-    csize( other.csize ) {
+// Copies the slots of a table of the same capacity; keys are shared, values are cloned.
+static void copyNodes( Dict::HNode* dst, const Dict::HNode* src, size_t cap ) {
+  for ( size_t i = 0; i < cap; ++i ) {
+    dst[i].key = src[i].key != NULL ? impl::__retainString( src[i].key ) : NULL;
+    dst[i].value = impl::__cloneValue( &src[i].value );
+  }
+}
+
+static void releaseNodes( Dict::HNode* nodes, size_t cap ) {
   for ( size_t i = 0; i < cap; ++i ) {
-    HNode& src = other.data[i];
-    HNode* dst = &data[i];
-    dst->key = src.key;
-    dst->value = impl::__cloneValue( &src.value );
+    if ( nodes[i].key != NULL ) {
+      impl::__releaseString( nodes[i].key );
+    }
   }
+
+  delete[] nodes;
+}
+
+static int8_t* copyCtrl( const int8_t* ctrl, size_t cap ) {
+  int8_t* copy = new int8_t[cap];
+  std::memcpy( copy, ctrl, cap );
+  return copy;
+}
+
+Dict::Dict( const Dict& other )
+  : data( new Dict::HNode[other.cap] ),
+    ctrl( copyCtrl( other.ctrl, other.cap ) ),
+    cap( other.cap ),
+    used( other.used ),
+    deleted( other.deleted ) {
+  copyNodes( data, other.data, cap );
 }
 
 Dict::Dict( Dict&& other )
   : data( other.data ),
+    ctrl( other.ctrl ),
     cap( other.cap ),
-    csize( other.csize ) {
+    used( other.used ),
+    deleted( other.deleted ) {
   other.data = NULL;
+  other.ctrl = NULL;
   other.cap = 0;
-  other.csize = {};
+  other.used = 0;
+  other.deleted = 0;
 }
 
 Dict& Dict::operator=( const Dict& other ) {
   if ( this != &other ) {
+    releaseNodes( data, cap );
+    delete[] ctrl;
+
     data = new HNode[other.cap];
+    ctrl = copyCtrl( other.ctrl, other.cap );
     cap = other.cap;
-    csize = other.csize;
+    used = other.used;
+    deleted = other.deleted;
 
-    for ( size_t i = 0; i < cap; ++i ) {
-      Dict::HNode& src = other.data[i];
-      Dict::HNode* dst = &data[i];
-      dst->key = src.key;
-      dst->value = impl::__cloneValue( &src.value );
-    }
+    copyNodes( data, other.data, cap );
   }
 
   return *this;
@@ -46,23 +71,37 @@ Dict& Dict::operator=( const Dict& other ) {
 
 Dict& Dict::operator=( Dict&& other ) {
   if ( this != &other ) {
+    releaseNodes( data, cap );
+    delete[] ctrl;
+
     data = other.data;
+    ctrl = other.ctrl;
     cap = other.cap;
-    csize = other.csize;
+    used = other.used;
+    deleted = other.deleted;
 
     other.data = NULL;
+    other.ctrl = NULL;
     other.cap = 0;
-    other.csize = {};
+    other.used = 0;
+    other.deleted = 0;
   }
 
   return *this;
 }
 
 Dict::Dict()
-  : data( new HNode[kDictCapacity] ) {}
+  : data( new HNode[kDictCapacity] ),
+    ctrl( new int8_t[kDictCapacity] ) {
+  std::memset( ctrl, kDictEmpty, kDictCapacity );
+}
 
 Dict::~Dict() {
-  delete[] data;
+  if ( data != NULL ) {
+    releaseNodes( data, cap );
+  }
+
+  delete[] ctrl;
 }
 
 } // namespace xvm
@@ -14,6 +14,7 @@
 
 #include "xvm_common.h"
 #include "xvm_value.h"
+#include "xvm_gc.h"
 
 /**
  * @namespace xvm
@@ -23,31 +24,44 @@
 namespace xvm {
 
 /**
- * @brief Default starting capacity for all dictionaries.
+ * @brief Default starting capacity for all dictionaries; capacities are powers of two.
  */
 inline constexpr size_t kDictCapacity = 64;
 
+inline constexpr size_t kDictGroup = 16;   ///< Slots whose control bytes are probed at once.
+inline constexpr int8_t kDictEmpty = -128; ///< Control byte of a slot that never held a key.
+inline constexpr int8_t kDictDeleted = -2; ///< Control byte of a slot whose key was removed.
+
 /**
  * @struct Dict
- * @brief A dynamically allocated hash table mapping `const char*` keys to `Value` objects.
+ * @brief A dynamically allocated hash table mapping interned string keys to `Value` objects.
+ *
+ * This dictionary implementation is based on open addressing over groups of
+ * `kDictGroup` slots. Every slot has a control byte, which is empty, deleted, or
+ * holds 7 bits of the hash of its key; a lookup compares the control bytes of a
+ * whole group at once, and only looks at the keys whose hash bits match. Probing
+ * stops at the first group with an empty slot, so removed keys leave a deleted
+ * marker until the table is rehashed.
+ * Keys are canonical strings of the state's `StringTable`, so they are compared by address.
+ * Nil values are not stored; assigning nil removes the key.
  *
- * This dictionary implementation is based on open addressing (linear probing).
- * Keys are raw C strings assumed to be interned or otherwise stable.
+ * Dictionaries are shared between values and copied on write; copies start with a single reference.
  */
-struct Dict {
+struct Dict : GcObject {
   /**
    * @struct HNode
    * @brief A single key-value entry within the dictionary hash table.
    */
   struct HNode {
-    const char* key; ///< Null-terminated string key (not owned).
-    Value value;     ///< Corresponding value.
+    String* key = NULL; ///< Interned key, or NULL if the slot is empty.
+    Value value;        ///< Corresponding value.
   };
 
   HNode* data = NULL;         ///< Pointer to the hash table buffer.
+  int8_t* ctrl = NULL;        ///< Control byte of every slot.
   size_t cap = kDictCapacity; ///< Total capacity of the table.
-  size_t csize;
-  bool cvalid;
+  size_t used = 0;            ///< Number of slots holding a key.
+  size_t deleted = 0;         ///< Number of slots marked deleted.
 
   XVM_IMPLCOPY( Dict ); ///< Enables copy constructor and assignment.
   XVM_IMPLMOVE( Dict ); ///< Enables move constructor and assignment.
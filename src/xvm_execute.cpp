@@ -4,50 +4,149 @@
 #include "xvm_state.h"
 #include "xvm_api_impl.h"
 #include "xvm_string.h"
-#include <cmath>
+#include "xvm_arith.h"
+#include "xvm_jit.h"
 
 #define VM_ERROR( message )                                                                        \
   {                                                                                                \
+    VM_SAVE();                                                                                     \
     __ethrow( state, message );                                                                    \
-    VM_NEXT();                                                                                     \
+    goto error;                                                                                    \
   }
 
 #define VM_ERRORF( message, ... )                                                                  \
   {                                                                                                \
+    VM_SAVE();                                                                                     \
     __ethrowf( state, message, __VA_ARGS__ );                                                      \
-    VM_NEXT();                                                                                     \
+    goto error;                                                                                    \
+  }
+
+// The dispatch loop keeps the program counter, register base and stack top in locals. They are
+// spilled back into the state object only around operations that observe them (calls, returns,
+// errors and exits), and reloaded afterwards as those operations may reposition them.
+// The local program counter points into the threaded instruction stream, while the state keeps
+// the corresponding bytecode address.
+#define VM_SAVE()                                                                                  \
+  {                                                                                                \
+    state->pc = fromThreaded( state, pc );                                                         \
+    state->stackTop = stackTop;                                                                    \
+  }
+
+#define VM_LOAD()                                                                                  \
+  {                                                                                                \
+    pc = toThreaded( state, state->pc );                                                           \
+    stackTop = state->stackTop;                                                                    \
+    regs = state->regBase;                                                                         \
   }
 
+#define VM_REG( reg ) ( regs + ( reg ) )
+
+// Inline cache of the current instruction. An overridden instruction is not part of the stream,
+// so it gets a cache of its own, which only lives for its single execution.
+#define VM_FIELD_CACHE()                                                                           \
+  ( SingleStep && OverrideProgramCounter ? &overrideCache                                          \
+                                          : &state->fieldCache[pc - state->threadedCode.data] )
 
 #define VM_DISPATCH()                                                                              \
   if constexpr ( SingleStep ) {                                                                    \
     goto exit;                                                                                     \
   }                                                                                                \
   else {                                                                                           \
-    goto dispatch;                                                                                 \
+    VM_DISPATCH_INSN();                                                                            \
   }
 
 #define VM_NEXT()                                                                                  \
   {                                                                                                \
     if constexpr ( SingleStep ) {                                                                  \
       if constexpr ( OverrideProgramCounter )                                                      \
-        state->pc = pc;                                                                            \
+        pc = savedPc;                                                                              \
       else                                                                                         \
-        state->pc++;                                                                               \
+        pc++;                                                                                      \
       goto exit;                                                                                   \
     }                                                                                              \
-    state->pc++;                                                                                   \
-    goto dispatch;                                                                                 \
+    pc++;                                                                                          \
+    VM_DISPATCH_INSN();                                                                            \
+  }
+
+#define VM_JUMP( offset )                                                                          \
+  {                                                                                                \
+    int16_t jumpOffset = offset;                                                                   \
+    pc += jumpOffset;                                                                              \
+    if ( jumpOffset < 0 ) {                                                                        \
+      VM_BACKEDGE();                                                                               \
+    }                                                                                              \
+    VM_DISPATCH();                                                                                 \
   }
 
+// Backward jumps lead to loop headers, which are counted and traced once hot. A trace runs until
+// one of its guards fails, after which the interpreter continues where it left.
+#if XVM_JIT
+#define VM_BACKEDGE()                                                                              \
+  if constexpr ( !SingleStep ) {                                                                   \
+    if XVM_UNLIKELY ( state->traceJit ) {                                                          \
+      VM_SAVE();                                                                                   \
+      traceLoop( state );                                                                          \
+      VM_LOAD();                                                                                   \
+    }                                                                                              \
+  }
+#else
+#define VM_BACKEDGE()
+#endif
+
 #define VM_CHECK_RETURN()                                                                          \
   if XVM_UNLIKELY ( state->callInfoTop == state->callInfoStack.data ) {                            \
     goto exit;                                                                                     \
   }
 
+// Handlers of quickened opcodes; a guard on the operand types followed by the specialized
+// operation. A failed guard de-quickens the instruction.
+#define VM_QUICK_ARITH( qop, op, type )                                                            \
+  VM_CASE( qop ) {                                                                                 \
+    Value* lhs = VM_REG( pc->a );                                                                  \
+    Value* rhs = VM_REG( pc->b );                                                                  \
+                                                                                                   \
+    if XVM_UNLIKELY ( lhs->kind() != ValueKind::type || rhs->kind() != ValueKind::type ) {         \
+      VM_DEQUICKEN( op );                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    auto result = lhs->as##type();                                                                 \
+    performArith( op, result, rhs->as##type() );                                                   \
+    lhs->set##type( result );                                                                      \
+    VM_NEXT();                                                                                     \
+  }
+
+#define VM_QUICK_COMPARE( qop, op, type, cmp )                                                     \
+  VM_CASE( qop ) {                                                                                 \
+    Value* lhs = VM_REG( pc->b );                                                                  \
+    Value* rhs = VM_REG( pc->c );                                                                  \
+                                                                                                   \
+    if XVM_UNLIKELY ( lhs->kind() != ValueKind::type || rhs->kind() != ValueKind::type ) {         \
+      VM_DEQUICKEN( op );                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    *VM_REG( pc->a ) = Value( lhs->as##type() cmp rhs->as##type() );                               \
+    VM_NEXT();                                                                                     \
+  }
+
+#define VM_QUICK_JUMP( qop, op, type, cmp )                                                        \
+  VM_CASE( qop ) {                                                                                 \
+    Value* lhs = VM_REG( pc->a );                                                                  \
+    Value* rhs = VM_REG( pc->b );                                                                  \
+                                                                                                   \
+    if XVM_UNLIKELY ( lhs->kind() != ValueKind::type || rhs->kind() != ValueKind::type ) {         \
+      VM_DEQUICKEN( op );                                                                          \
+    }                                                                                              \
+                                                                                                   \
+    if ( lhs->as##type() cmp rhs->as##type() ) {                                                   \
+      VM_JUMP( (int16_t)pc->c );                                                                   \
+    }                                                                                              \
+                                                                                                   \
+    VM_NEXT();                                                                                     \
+  }
+
 // Stolen from Luau :)
 // Whether to use a dispatch table for instruction loading.
-#define VM_USE_CGOTO XVMC == CGCC || XVMC == CCLANG
+#define VM_USE_CGOTO ( XVMC == CGCC || XVMC == CCLANG )
 
 #if VM_USE_CGOTO
 #define VM_CASE( op ) CASE_##op:
@@ -55,6 +154,70 @@
 #define VM_CASE( op ) case op:
 #endif
 
+// With computed gotos, every handler jumps straight to the pre-resolved handler of the next
+// instruction in the threaded stream. Otherwise (and for the single-step interpreter, which has
+// its own handler addresses) dispatch goes through the dispatch table or switch.
+#if VM_USE_CGOTO
+#define VM_DISPATCH_INSN()                                                                         \
+  {                                                                                                \
+    VM_PROFILE_INSN();                                                                             \
+    goto* pc->handler;                                                                             \
+  }
+#else
+#define VM_DISPATCH_INSN() goto dispatch
+#endif
+
+#if XVM_OPCODE_PROFILE
+#define VM_PROFILE_INSN() __profileInstruction( &state->opcodeProfile, fromThreaded( state, pc ) )
+#else
+#define VM_PROFILE_INSN()
+#endif
+
+// Ends the first instruction of a superinstruction by jumping directly into the handler of the next
+// one, skipping its dispatch. The instructions making up a superinstruction are kept in the
+// threaded stream, so the next handler reads its own operands.
+#if VM_USE_CGOTO
+#define VM_FUSED_NEXT( op )                                                                        \
+  {                                                                                                \
+    if constexpr ( SingleStep ) {                                                                  \
+      VM_NEXT();                                                                                   \
+    }                                                                                              \
+    pc++;                                                                                          \
+    goto CASE_##op;                                                                                \
+  }
+#else
+#define VM_FUSED_NEXT( op ) VM_NEXT()
+#endif
+
+// Rewrites the current instruction in place into a type-specialized (quickened) opcode, or back
+// into its generic opcode when the specialization guard fails, after which the generic handler is
+// re-executed. The single-step interpreter does not know the handler addresses of the threaded
+// interpreter, so it only executes quickened instructions and never rewrites them.
+#if VM_USE_CGOTO
+#define VM_QUICKEN( qop )                                                                          \
+  if constexpr ( !SingleStep ) {                                                                   \
+    pc->op = qop;                                                                                  \
+    pc->handler = dispatch_table[(uint16_t)qop];                                                   \
+  }
+
+#define VM_DEQUICKEN( op )                                                                         \
+  {                                                                                                \
+    VM_QUICKEN( op );                                                                              \
+    goto* dispatch_table[(uint16_t)op];                                                            \
+  }
+#else
+#define VM_QUICKEN( qop )                                                                          \
+  {                                                                                                \
+    pc->op = qop;                                                                                  \
+  }
+
+#define VM_DEQUICKEN( op )                                                                         \
+  {                                                                                                \
+    VM_QUICKEN( op );                                                                              \
+    goto dispatch;                                                                                 \
+  }
+#endif
+
 #define VM_DISPATCH_OP( op ) &&CASE_##op
 #define VM_DISPATCH_TABLE()                                                                        \
   VM_DISPATCH_OP( NOP ), VM_DISPATCH_OP( LBL ), VM_DISPATCH_OP( EXIT ), VM_DISPATCH_OP( ADD ),     \
@@ -77,14 +240,29 @@
     VM_DISPATCH_OP( JMP ), VM_DISPATCH_OP( JMPIF ), VM_DISPATCH_OP( JMPIFN ),                      \
     VM_DISPATCH_OP( JMPIFEQ ), VM_DISPATCH_OP( JMPIFNEQ ), VM_DISPATCH_OP( JMPIFLT ),              \
     VM_DISPATCH_OP( JMPIFGT ), VM_DISPATCH_OP( JMPIFLTEQ ), VM_DISPATCH_OP( JMPIFGTEQ ),           \
-    VM_DISPATCH_OP( CALL ), VM_DISPATCH_OP( PCALL ), VM_DISPATCH_OP( RET ),                        \
-    VM_DISPATCH_OP( RETBT ), VM_DISPATCH_OP( RETBF ), VM_DISPATCH_OP( RETNIL ),                    \
+    VM_DISPATCH_OP( CALL ), VM_DISPATCH_OP( PCALL ), VM_DISPATCH_OP( TAILCALL ),                   \
+    VM_DISPATCH_OP( RET ), VM_DISPATCH_OP( RETBT ), VM_DISPATCH_OP( RETBF ),                       \
+    VM_DISPATCH_OP( RETNIL ),                                                                      \
     VM_DISPATCH_OP( GETARR ), VM_DISPATCH_OP( SETARR ), VM_DISPATCH_OP( NEXTARR ),                 \
-    VM_DISPATCH_OP( LENARR ), VM_DISPATCH_OP( GETDICT ), VM_DISPATCH_OP( SETDICT ),                \
-    VM_DISPATCH_OP( NEXTDICT ), VM_DISPATCH_OP( LENDICT ), VM_DISPATCH_OP( CONSTR ),               \
-    VM_DISPATCH_OP( GETSTR ), VM_DISPATCH_OP( SETSTR ), VM_DISPATCH_OP( LENSTR ),                  \
+    VM_DISPATCH_OP( LENARR ), VM_DISPATCH_OP( APPENDARR ), VM_DISPATCH_OP( POPARR ),               \
+    VM_DISPATCH_OP( GETDICT ), VM_DISPATCH_OP( SETDICT ),                                          \
+    VM_DISPATCH_OP( NEXTDICT ), VM_DISPATCH_OP( LENDICT ), VM_DISPATCH_OP( GETDICTK ),             \
+    VM_DISPATCH_OP( SETDICTK ), VM_DISPATCH_OP( CONSTR ), VM_DISPATCH_OP( GETSTR ),                \
+    VM_DISPATCH_OP( SETSTR ), VM_DISPATCH_OP( LENSTR ),                                            \
     VM_DISPATCH_OP( ICAST ), VM_DISPATCH_OP( FCAST ), VM_DISPATCH_OP( STRCAST ),                   \
-    VM_DISPATCH_OP( BCAST )
+    VM_DISPATCH_OP( BCAST ), VM_DISPATCH_OP( ADDII ), VM_DISPATCH_OP( ADDFF ),                     \
+    VM_DISPATCH_OP( SUBII ), VM_DISPATCH_OP( SUBFF ), VM_DISPATCH_OP( MULII ),                     \
+    VM_DISPATCH_OP( MULFF ), VM_DISPATCH_OP( DIVII ), VM_DISPATCH_OP( DIVFF ),                     \
+    VM_DISPATCH_OP( MODII ), VM_DISPATCH_OP( MODFF ), VM_DISPATCH_OP( POWII ),                     \
+    VM_DISPATCH_OP( POWFF ), VM_DISPATCH_OP( LTII ), VM_DISPATCH_OP( LTFF ),                       \
+    VM_DISPATCH_OP( GTII ), VM_DISPATCH_OP( GTFF ), VM_DISPATCH_OP( LTEQII ),                      \
+    VM_DISPATCH_OP( LTEQFF ), VM_DISPATCH_OP( GTEQII ), VM_DISPATCH_OP( GTEQFF ),                  \
+    VM_DISPATCH_OP( JMPIFLTII ), VM_DISPATCH_OP( JMPIFLTFF ), VM_DISPATCH_OP( JMPIFGTII ),         \
+    VM_DISPATCH_OP( JMPIFGTFF ), VM_DISPATCH_OP( JMPIFLTEQII ), VM_DISPATCH_OP( JMPIFLTEQFF ),     \
+    VM_DISPATCH_OP( JMPIFGTEQII ), VM_DISPATCH_OP( JMPIFGTEQFF )                                   \
+      XVM_SUPERINSN_LIST( VM_DISPATCH_SUPERINSN )
+
+#define VM_DISPATCH_SUPERINSN( name, ... ) , VM_DISPATCH_OP( name )
 
 namespace xvm {
 
@@ -93,133 +271,102 @@ using enum Opcode;
 // We use implementation functions only in this file.
 using namespace impl;
 
-static bool isArithOpcode( Opcode op ) {
-  return (uint16_t)op >= (uint16_t)ADD && (uint16_t)op <= (uint16_t)FPOW;
-}
-
-template<typename A, typename B = A>
-static XVM_FORCEINLINE void performArith( Opcode op, A& a, B b ) {
-  switch ( op ) {
-  case ADD:
-  case IADD:
-  case FADD:
-    a += b;
-    break;
-  case SUB:
-  case ISUB:
-  case FSUB:
-    a -= b;
-    break;
-  case MUL:
-  case IMUL:
-  case FMUL:
-    a *= b;
-    break;
-  case DIV:
-  case IDIV:
-  case FDIV:
-    a /= b;
-    break;
-  case MOD:
-  case IMOD:
-  case FMOD:
-    a = std::fmod( a, b );
-    break;
-  case POW:
-  case IPOW:
-  case FPOW:
-    a = std::pow( a, b );
-    break;
-  default:
-    break;
-  }
-}
-
-static XVM_FORCEINLINE int arith( State* state, Opcode op, Value* lhs, Value* rhs ) {
+// Returns the type-specialized variant of a generic arithmetic or comparison opcode for the
+// observed operand types, or NOP if the operands do not qualify for specialization.
+static Opcode getQuickenedOpcode( Opcode op, ValueKind lhs, ValueKind rhs ) {
   using enum ValueKind;
 
-  if ( !isArithOpcode( op ) ) {
-    return 1;
+  if ( lhs != rhs || ( lhs != Int && lhs != Float ) ) {
+    return NOP;
   }
 
-  if ( lhs->type == Int && rhs->type == Int ) {
-    performArith( op, lhs->u.i, rhs->u.i );
-  }
-  else {
-    auto as_float = []( const Value& v ) -> float {
-      return v.type == Int ? static_cast<float>( v.u.i ) : v.u.f;
-    };
-
-    float a = as_float( *lhs );
-    float b = as_float( *rhs );
-
-    performArith( op, a, b );
+  bool isInt = lhs == Int;
 
-    lhs->u.f = a;
-    lhs->type = ValueKind::Float;
-  }
-
-  return 0;
+  // clang-format off
+  switch ( op ) {
+  case ADD:       return isInt ? ADDII : ADDFF;
+  case SUB:       return isInt ? SUBII : SUBFF;
+  case MUL:       return isInt ? MULII : MULFF;
+  case DIV:       return isInt ? DIVII : DIVFF;
+  case MOD:       return isInt ? MODII : MODFF;
+  case POW:       return isInt ? POWII : POWFF;
+  case LT:        return isInt ? LTII : LTFF;
+  case GT:        return isInt ? GTII : GTFF;
+  case LTEQ:      return isInt ? LTEQII : LTEQFF;
+  case GTEQ:      return isInt ? GTEQII : GTEQFF;
+  case JMPIFLT:   return isInt ? JMPIFLTII : JMPIFLTFF;
+  case JMPIFGT:   return isInt ? JMPIFGTII : JMPIFGTFF;
+  case JMPIFLTEQ: return isInt ? JMPIFLTEQII : JMPIFLTEQFF;
+  case JMPIFGTEQ: return isInt ? JMPIFGTEQII : JMPIFGTEQFF;
+  default:        return NOP;
+  } // clang-format on
 }
 
-static XVM_FORCEINLINE void iarith( State* state, Opcode op, Value* lhs, int i ) {
-  using enum ValueKind;
-
-  if XVM_LIKELY ( lhs->type == Int ) {
-    performArith( op, lhs->u.i, i );
-  }
-  else if ( lhs->type == Float ) {
-    performArith( op, lhs->u.f, i );
-  }
+static inline XVM_FORCEINLINE ThreadedInstruction*
+toThreaded( State* state, const Instruction* pc ) {
+  return pc != NULL ? state->threadedCode.data + ( pc - state->bcHolder.data() ) : NULL;
 }
 
-static XVM_FORCEINLINE void farith( State* state, Opcode op, Value* lhs, float f ) {
-  using enum ValueKind;
-
-  if XVM_LIKELY ( lhs->type == Int ) {
-    performArith( op, lhs->u.i, f );
-  }
-  else if ( lhs->type == Float ) {
-    performArith( op, lhs->u.f, f );
-  }
+static inline XVM_FORCEINLINE const Instruction*
+fromThreaded( const State* state, const ThreadedInstruction* pc ) {
+  return pc != NULL ? state->bcHolder.data() + ( pc - state->threadedCode.data ) : NULL;
 }
 
 template<const bool SingleStep = false, const bool OverrideProgramCounter = false>
 static void execute( State* state, Instruction insn = Instruction() ) {
 #if VM_USE_CGOTO
   static constexpr void* dispatch_table[0xFF] = { VM_DISPATCH_TABLE() };
-#endif
 
-dispatch:
-  const Instruction* pc = state->pc;
+  // Resolve handler addresses of the threaded instruction stream. This is done once per state,
+  // as handler addresses are only known to the interpreter itself.
+  if constexpr ( !SingleStep ) {
+    if XVM_UNLIKELY ( !state->threaded ) {
+      for ( size_t i = 0; i < state->threadedCode.size; i++ ) {
+        ThreadedInstruction& tinsn = state->threadedCode.data[i];
+        tinsn.handler = dispatch_table[(uint16_t)tinsn.op];
+      }
 
-  // Check for errors and attempt handling them.
-  // The __ehandle function works by unwinding the stack until
-  // either hitting a stack frame flagged as error handler, or, the root
-  // stack frame, and the root stack frame cannot be an error handler
-  // under any circumstances. Therefore the error will act as a fatal
-  // error, being automatically thrown by __ehandle, along with a
-  // cstk and debug information.
-  if ( __echeck( state ) && !__ehandle( state ) ) {
-    goto exit;
+      state->threaded = true;
+    }
   }
+#endif
+
+  ThreadedInstruction* pc = toThreaded( state, state->pc );
+  Value* regs = state->regBase;
+  Value* stackTop = state->stackTop;
+
+  // Program counter to restore after executing an overridden instruction.
+  [[maybe_unused]] ThreadedInstruction* const savedPc = pc;
+  [[maybe_unused]] ThreadedInstruction overrideInsn;
+  [[maybe_unused]] uint32_t overrideCache = 0;
 
   if constexpr ( SingleStep && OverrideProgramCounter ) {
-    state->pc = &insn;
+    overrideInsn.op = insn.op;
+    overrideInsn.a = insn.a;
+    overrideInsn.b = insn.b;
+    overrideInsn.c = insn.c;
+    pc = &overrideInsn;
   }
 
+  // Only the switch dispatch loops back here; computed gotos jump between handlers directly.
+#if !VM_USE_CGOTO
+dispatch:
+#endif
+  VM_PROFILE_INSN();
+
 #if VM_USE_CGOTO
-  goto* dispatch_table[(uint16_t)state->pc->op];
+  if constexpr ( SingleStep ) {
+    goto* dispatch_table[(uint16_t)pc->op];
+  }
+  else {
+    goto* pc->handler;
+  }
 #else
-  switch ( state->pc->op )
+  switch ( pc->op )
 #endif
   {
     // Handle special/opcodes
     VM_CASE( NOP )
-    VM_CASE( GETDICT )
-    VM_CASE( SETDICT )
-    VM_CASE( LENDICT )
-    VM_CASE( NEXTDICT )
     VM_CASE( CAPTURE )
     VM_CASE( LBL ) {
       VM_NEXT();
@@ -231,13 +378,19 @@ dispatch:
     VM_CASE( DIV )
     VM_CASE( MOD )
     VM_CASE( POW ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+
+      Value* lhs = VM_REG( ra );
+      Value* rhs = VM_REG( rb );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
 
-      Value* lhs = __getRegister( state, ra );
-      Value* rhs = __getRegister( state, rb );
+      arith( pc->op, lhs, rhs );
+
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
 
-      arith( state, pc->op, lhs, rhs );
       VM_NEXT();
     }
 
@@ -247,14 +400,14 @@ dispatch:
     VM_CASE( IDIV )
     VM_CASE( IMOD )
     VM_CASE( IPOW ) {
-      uint16_t ra = state->pc->a;
-      uint16_t ib = state->pc->b;
-      uint16_t ic = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t ib = pc->b;
+      uint16_t ic = pc->c;
 
-      int imm = ( (uint32_t)ic << 16 ) | ib;
-      Value* lhs = __getRegister( state, ra );
+      Integer imm = decodeIntImmediate( ic, ib );
+      Value* lhs = VM_REG( ra );
 
-      iarith( state, pc->op, lhs, imm );
+      iarith( pc->op, lhs, imm );
       VM_NEXT();
     }
 
@@ -264,138 +417,155 @@ dispatch:
     VM_CASE( FDIV )
     VM_CASE( FMOD )
     VM_CASE( FPOW ) {
-      uint16_t ra = state->pc->a;
-      uint16_t fb = state->pc->b;
-      uint16_t fc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t fb = pc->b;
+      uint16_t fc = pc->c;
 
-      float imm = ( (uint32_t)fc << 16 ) | fb;
-      Value* lhs = __getRegister( state, ra );
+      Real imm = decodeFloatImmediate( fc, fb );
+      Value* lhs = VM_REG( ra );
 
-      farith( state, pc->op, lhs, imm );
+      farith( pc->op, lhs, imm );
       VM_NEXT();
     }
 
     VM_CASE( NEG ) {
-      uint16_t ra = state->pc->a;
-      Value* val = __getRegister( state, ra );
-      ValueKind type = val->type;
+      uint16_t ra = pc->a;
+      Value* val = VM_REG( ra );
+      ValueKind type = val->kind();
 
       if ( type == ValueKind::Int ) {
-        val->u.i = -val->u.i;
+        val->setInt( -val->asInt() );
       }
       else if ( type == ValueKind::Float ) {
-        val->u.f = -val->u.f;
+        val->setFloat( -val->asFloat() );
       }
 
       VM_NEXT();
     }
 
     VM_CASE( MOV ) {
-      uint16_t rdst = state->pc->a;
-      uint16_t rsrc = state->pc->b;
-      Value* src_val = __getRegister( state, rsrc );
+      uint16_t rdst = pc->a;
+      uint16_t rsrc = pc->b;
+      Value* src_val = VM_REG( rsrc );
 
-      __setRegister( state, rdst, __cloneValue( src_val ) );
+      *VM_REG( rdst ) = __cloneValue( src_val );
       VM_NEXT();
     }
 
     VM_CASE( INC ) {
-      uint16_t rdst = state->pc->a;
-      Value* dst_val = __getRegister( state, rdst );
+      uint16_t rdst = pc->a;
+      Value* dst_val = VM_REG( rdst );
 
-      if XVM_LIKELY ( dst_val->type == ValueKind::Int ) {
-        dst_val->u.i++;
+      if XVM_LIKELY ( dst_val->kind() == ValueKind::Int ) {
+        dst_val->setInt( dst_val->asInt() + 1 );
       }
-      else if XVM_UNLIKELY ( dst_val->type == ValueKind::Float ) {
-        dst_val->u.f++;
+      else if XVM_UNLIKELY ( dst_val->kind() == ValueKind::Float ) {
+        dst_val->setFloat( dst_val->asFloat() + 1 );
       }
 
       VM_NEXT();
     }
 
     VM_CASE( DEC ) {
-      uint16_t rdst = state->pc->a;
-      Value* dst_val = __getRegister( state, rdst );
+      uint16_t rdst = pc->a;
+      Value* dst_val = VM_REG( rdst );
 
-      if XVM_LIKELY ( dst_val->type == ValueKind::Int ) {
-        dst_val->u.i--;
+      if XVM_LIKELY ( dst_val->kind() == ValueKind::Int ) {
+        dst_val->setInt( dst_val->asInt() - 1 );
       }
-      else if XVM_UNLIKELY ( dst_val->type == ValueKind::Float ) {
-        dst_val->u.f--;
+      else if XVM_UNLIKELY ( dst_val->kind() == ValueKind::Float ) {
+        dst_val->setFloat( dst_val->asFloat() - 1 );
       }
 
       VM_NEXT();
     }
 
     VM_CASE( LOADK ) {
-      uint16_t ra = state->pc->a;
-      uint16_t idx = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t idx = pc->b;
 
       const Value& kval = __getConstant( state, idx );
 
-      __setRegister( state, ra, __cloneValue( &kval ) );
+      *VM_REG( ra ) = __cloneValue( &kval );
       VM_NEXT();
     }
 
     VM_CASE( LOADNIL ) {
-      uint16_t ra = state->pc->a;
+      uint16_t ra = pc->a;
 
-      __setRegister( state, ra, XVM_NIL );
+      *VM_REG( ra ) = XVM_NIL;
       VM_NEXT();
     }
 
     VM_CASE( LOADI ) {
-      uint16_t ra = state->pc->a;
-      int imm = ( (uint32_t)state->pc->b << 16 ) | state->pc->a;
+      uint16_t ra = pc->a;
+      Integer imm = decodeIntImmediate( pc->c, pc->b );
 
-      __setRegister( state, ra, Value( imm ) );
+      *VM_REG( ra ) = Value( imm );
       VM_NEXT();
     }
 
     VM_CASE( LOADF ) {
-      uint16_t ra = state->pc->a;
-      float imm = ( (uint32_t)state->pc->b << 16 ) | state->pc->a;
+      uint16_t ra = pc->a;
+      Real imm = decodeFloatImmediate( pc->c, pc->b );
 
-      __setRegister( state, ra, Value( imm ) );
+      *VM_REG( ra ) = Value( imm );
       VM_NEXT();
     }
 
     VM_CASE( LOADBT ) {
-      uint16_t ra = state->pc->a;
+      uint16_t ra = pc->a;
 
-      __setRegister( state, ra, Value( true ) );
+      *VM_REG( ra ) = Value( true );
       VM_NEXT();
     }
 
     VM_CASE( LOADBF ) {
-      uint16_t ra = state->pc->a;
+      uint16_t ra = pc->a;
 
-      __setRegister( state, ra, Value( false ) );
+      *VM_REG( ra ) = Value( false );
       VM_NEXT();
     }
 
     VM_CASE( LOADARR ) {
-      uint16_t ra = state->pc->a;
+      uint16_t ra = pc->a;
+      uint16_t hint = pc->b;
+      uint16_t kind = pc->c;
+
+      // The optional b operand preallocates room for that many elements, and the optional c
+      // operand selects unboxed storage for Int or Float elements.
+      size_t capacity = hint != OPERAND_INVALID && hint != 0 ? hint : kArrayCapacity;
+      ArrayKind elems = kind <= (uint16_t)ArrayKind::Float ? (ArrayKind)kind : ArrayKind::Generic;
 
-      Value arr( new Array() );
+      Value arr( new Array( capacity, elems ) );
+      gcTrack( state, arr.asArray(), ValueKind::Array );
 
-      __setRegister( state, ra, std::move( arr ) );
+      *VM_REG( ra ) = std::move( arr );
+
+      VM_SAVE();
+      gcCheck( state );
       VM_NEXT();
     }
 
     VM_CASE( LOADDICT ) {
-      uint16_t ra = state->pc->a;
+      uint16_t ra = pc->a;
 
       Value dict( new Dict() );
+      gcTrack( state, dict.asDict(), ValueKind::Dict );
+
+      *VM_REG( ra ) = std::move( dict );
 
-      __setRegister( state, ra, std::move( dict ) );
+      VM_SAVE();
+      gcCheck( state );
       VM_NEXT();
     }
 
     VM_CASE( CLOSURE ) {
-      uint16_t ra = state->pc->a;
-      uint16_t lb = state->pc->b;
-      uint16_t cc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t lb = pc->b;
+      uint16_t cc = pc->c;
+
+      VM_SAVE();
 
       const auto& data = __getAddressData( state, state->pc );
       const std::string& comment = data.comment;
@@ -406,6 +576,7 @@ dispatch:
 
       Function f;
       f.id = idbuf;
+      f.regCount = state->closureRegCounts[state->pc - state->bcHolder.data()];
       f.code = ++state->pc;
       f.size = lb;
 
@@ -414,266 +585,273 @@ dispatch:
       c.type = CallableKind::Function;
       c.u = { .fn = std::move( f ) };
 
-      Closure* closure = new Closure();
-      closure->callee = std::move( c );
+      Closure* closure = new Closure( std::move( c ) );
+      gcTrack( state, closure, ValueKind::Function );
 
       __initClosure( state, closure, lb );
-      __setRegister( state, ra, Value( closure ) );
+      *VM_REG( ra ) = Value( closure );
+      gcCheck( state );
 
       // Do not increment program counter, as __initClosure automatically positions it
       // to the correct instruction.
+      VM_LOAD();
       VM_DISPATCH();
     }
 
     VM_CASE( GETUPV ) {
-      uint16_t ra = state->pc->a;
-      uint16_t ib = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t ib = pc->b;
 
       UpValue* upv = __getClosureUpv( ( state->callInfoTop - 1 )->closure, ib );
 
-      __setRegister( state, ra, __cloneValue( upv->value ) );
+      *VM_REG( ra ) = __cloneValue( upv->value );
       VM_NEXT();
     }
 
     VM_CASE( SETUPV ) {
-      uint16_t ra = state->pc->a;
-      uint16_t upv_id = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t upv_id = pc->b;
 
-      Value* val = __getRegister( state, ra );
+      Value* val = VM_REG( ra );
 
-      __setClosureUpv( ( state->callInfoTop - 1 )->closure, upv_id, val );
+      __setClosureUpv( state, ( state->callInfoTop - 1 )->closure, upv_id, val );
       VM_NEXT();
     }
 
     VM_CASE( PUSH ) {
-      uint16_t ra = state->pc->a;
-      Value* val = __getRegister( state, ra );
+      uint16_t ra = pc->a;
+      Value* val = VM_REG( ra );
 
-      __pushStack( state, std::move( *val ) );
+      *( stackTop++ ) = std::move( *val );
       VM_NEXT();
     }
 
     VM_CASE( PUSHK ) {
-      uint16_t const_idx = state->pc->a;
+      uint16_t const_idx = pc->a;
       Value constant = __getConstant( state, const_idx );
 
-      __pushStack( state, std::move( constant ) );
+      *( stackTop++ ) = std::move( constant );
       VM_NEXT();
     }
 
     VM_CASE( PUSHNIL ) {
-      __pushStack( state, XVM_NIL );
+      *( stackTop++ ) = XVM_NIL;
       VM_NEXT();
     }
 
     VM_CASE( PUSHI ) {
-      int imm = ( (uint32_t)state->pc->b << 16 ) | state->pc->a;
-      __pushStack( state, Value( imm ) );
+      Integer imm = decodeIntImmediate( pc->b, pc->a );
+      *( stackTop++ ) = Value( imm );
       VM_NEXT();
     }
 
     VM_CASE( PUSHF ) {
-      float imm = ( (uint32_t)state->pc->b << 16 ) | state->pc->a;
-      __pushStack( state, Value( imm ) );
+      Real imm = decodeFloatImmediate( pc->b, pc->a );
+      *( stackTop++ ) = Value( imm );
       VM_NEXT();
     }
 
     VM_CASE( PUSHBT ) {
-      __pushStack( state, Value( true ) );
+      *( stackTop++ ) = Value( true );
       VM_NEXT();
     }
 
     VM_CASE( PUSHBF ) {
-      __pushStack( state, Value( false ) );
+      *( stackTop++ ) = Value( false );
       VM_NEXT();
     }
 
     VM_CASE( DROP ) {
-      __dropStack( state );
+      __resetValue( --stackTop );
       VM_NEXT();
     }
 
     VM_CASE( GETLOCAL ) {
-      uint16_t ra = state->pc->a;
-      uint16_t off = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t off = pc->b;
       Value* val = __getLocal( state, off );
 
-      __setRegister( state, ra, __cloneValue( val ) );
+      *VM_REG( ra ) = __cloneValue( val );
       VM_NEXT();
     }
 
     VM_CASE( SETLOCAL ) {
-      uint16_t ra = state->pc->a;
-      uint16_t off = state->pc->b;
-      Value* val = __getRegister( state, ra );
+      uint16_t ra = pc->a;
+      uint16_t off = pc->b;
+      Value* val = VM_REG( ra );
 
       __setLocal( state, off, std::move( *val ) );
       VM_NEXT();
     }
 
     VM_CASE( GETARG ) {
-      uint16_t ra = state->pc->a;
-      uint16_t off = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t off = pc->b;
 
       Value* val = state->stackBase - off - 1;
 
-      __setRegister( state, ra, __cloneValue( val ) );
+      *VM_REG( ra ) = __cloneValue( val );
       VM_NEXT();
     }
 
     VM_CASE( GETGLOBAL ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* key = __getRegister( state, rb );
-      Value* global = __getGlobal( state, key->u.str->data );
+      Value* key = VM_REG( rb );
+      Value* global = __getGlobalCached( state, key->asString(), VM_FIELD_CACHE() );
 
-      __setRegister( state, ra, __cloneValue( global ) );
+      *VM_REG( ra ) = global != NULL ? __cloneValue( global ) : XVM_NIL;
       VM_NEXT();
     }
 
     VM_CASE( SETGLOBAL ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* key = __getRegister( state, rb );
-      Value* global = __getRegister( state, ra );
+      Value* key = VM_REG( rb );
+      Value* global = VM_REG( ra );
 
-      __setGlobal( state, key->u.str->data, std::move( *global ) );
+      __setGlobalCached( state, key->asString(), std::move( *global ), VM_FIELD_CACHE() );
       VM_NEXT();
     }
 
     VM_CASE( EQ ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
 
       if XVM_UNLIKELY ( rb == rc ) {
-        __setRegister( state, ra, Value( true ) );
+        *VM_REG( ra ) = Value( true );
         VM_NEXT();
       }
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
 
       if XVM_UNLIKELY ( lhs == rhs ) {
-        __setRegister( state, ra, Value( true ) );
+        *VM_REG( ra ) = Value( true );
         VM_NEXT();
       }
 
       bool result = __compareValue( lhs, rhs );
-      __setRegister( state, ra, Value( result ) );
+      *VM_REG( ra ) = Value( result );
 
       VM_NEXT();
     }
 
     VM_CASE( DEQ ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
 
       if XVM_UNLIKELY ( rb == rc ) {
-        __setRegister( state, ra, Value( true ) );
+        *VM_REG( ra ) = Value( true );
         VM_NEXT();
       }
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
 
       if XVM_UNLIKELY ( lhs == rhs ) {
-        __setRegister( state, ra, Value( true ) );
+        *VM_REG( ra ) = Value( true );
         VM_NEXT();
       }
 
       bool result = __deepCompareValue( lhs, rhs );
-      __setRegister( state, ra, Value( result ) );
+      *VM_REG( ra ) = Value( result );
 
       VM_NEXT();
     }
 
     VM_CASE( NEQ ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
 
       if XVM_LIKELY ( rb != rc ) {
-        __setRegister( state, ra, Value( true ) );
+        *VM_REG( ra ) = Value( true );
         VM_NEXT();
       }
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
 
       if XVM_LIKELY ( lhs != rhs ) {
-        __setRegister( state, ra, Value( true ) );
+        *VM_REG( ra ) = Value( true );
         VM_NEXT();
       }
 
       bool result = __compareValue( lhs, rhs );
-      __setRegister( state, ra, Value( result ) );
+      *VM_REG( ra ) = Value( result );
 
       VM_NEXT();
     }
 
     VM_CASE( AND ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
       bool cond = __toBool( lhs ) && __toBool( rhs );
 
-      __setRegister( state, ra, Value( cond ) );
+      *VM_REG( ra ) = Value( cond );
       VM_NEXT();
     }
 
     VM_CASE( OR ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
       bool cond = __toBool( lhs ) || __toBool( rhs );
 
-      __setRegister( state, ra, Value( cond ) );
+      *VM_REG( ra ) = Value( cond );
       VM_NEXT();
     }
 
     VM_CASE( NOT ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* lhs = __getRegister( state, rb );
+      Value* lhs = VM_REG( rb );
       bool cond = !__toBool( lhs );
 
-      __setRegister( state, ra, Value( cond ) );
+      *VM_REG( ra ) = Value( cond );
       VM_NEXT();
     }
 
     VM_CASE( LT ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
+
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
 
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.i < rhs->u.i ) );
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asInt() < rhs->asInt() );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( static_cast<float>( lhs->u.i ) < rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( static_cast<Real>( lhs->asInt() ) < rhs->asFloat() );
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.f < static_cast<float>( rhs->u.i ) ) );
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() < static_cast<Real>( rhs->asInt() ) );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( lhs->u.f < rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() < rhs->asFloat() );
         }
       }
 
@@ -681,27 +859,32 @@ dispatch:
     }
 
     VM_CASE( GT ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
+
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
 
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.i > rhs->u.i ) );
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asInt() > rhs->asInt() );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( static_cast<float>( lhs->u.i ) > rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( static_cast<Real>( lhs->asInt() ) > rhs->asFloat() );
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.f > static_cast<float>( rhs->u.i ) ) );
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() > static_cast<Real>( rhs->asInt() ) );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( lhs->u.f > rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() > rhs->asFloat() );
         }
       }
 
@@ -709,27 +892,32 @@ dispatch:
     }
 
     VM_CASE( LTEQ ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
 
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.i <= rhs->u.i ) );
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
+
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asInt() <= rhs->asInt() );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( static_cast<float>( lhs->u.i ) <= rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( static_cast<Real>( lhs->asInt() ) <= rhs->asFloat() );
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.f <= static_cast<float>( rhs->u.i ) ) );
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() <= static_cast<Real>( rhs->asInt() ) );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( lhs->u.f <= rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() <= rhs->asFloat() );
         }
       }
 
@@ -737,27 +925,32 @@ dispatch:
     }
 
     VM_CASE( GTEQ ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t rc = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
+
+      Value* lhs = VM_REG( rb );
+      Value* rhs = VM_REG( rc );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
 
-      Value* lhs = __getRegister( state, rb );
-      Value* rhs = __getRegister( state, rc );
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
 
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.i >= rhs->u.i ) );
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asInt() >= rhs->asInt() );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( static_cast<float>( lhs->u.i ) >= rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( static_cast<Real>( lhs->asInt() ) >= rhs->asFloat() );
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          __setRegister( state, ra, Value( lhs->u.f >= static_cast<float>( rhs->u.i ) ) );
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() >= static_cast<Real>( rhs->asInt() ) );
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          __setRegister( state, ra, Value( lhs->u.f >= rhs->u.f ) );
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          *VM_REG( ra ) = Value( lhs->asFloat() >= rhs->asFloat() );
         }
       }
 
@@ -769,53 +962,48 @@ dispatch:
     }
 
     VM_CASE( JMP ) {
-      int16_t offset = state->pc->a;
-      state->pc += offset;
-      goto dispatch;
+      int16_t offset = pc->a;
+      VM_JUMP( offset );
     }
 
     VM_CASE( JMPIF ) {
-      uint16_t cond = state->pc->a;
-      int16_t offset = state->pc->b;
+      uint16_t cond = pc->a;
+      int16_t offset = pc->b;
 
-      Value* cond_val = __getRegister( state, cond );
+      Value* cond_val = VM_REG( cond );
       if ( __toBool( cond_val ) ) {
-        state->pc += offset;
-        goto dispatch;
+        VM_JUMP( offset );
       }
 
       VM_NEXT();
     }
 
     VM_CASE( JMPIFN ) {
-      uint16_t cond = state->pc->a;
-      int16_t offset = state->pc->b;
+      uint16_t cond = pc->a;
+      int16_t offset = pc->b;
 
-      Value* cond_val = __getRegister( state, cond );
+      Value* cond_val = VM_REG( cond );
       if ( !__toBool( cond_val ) ) {
-        state->pc += offset;
-        goto dispatch;
+        VM_JUMP( offset );
       }
 
       VM_NEXT();
     }
 
     VM_CASE( JMPIFEQ ) {
-      uint16_t cond_lhs = state->pc->a;
-      uint16_t cond_rhs = state->pc->b;
-      int16_t offset = state->pc->c;
+      uint16_t cond_lhs = pc->a;
+      uint16_t cond_rhs = pc->b;
+      int16_t offset = pc->c;
 
       if XVM_UNLIKELY ( cond_lhs == cond_rhs ) {
-        state->pc += offset;
-        goto dispatch;
+        VM_JUMP( offset );
       }
       else {
-        Value* lhs = __getRegister( state, cond_lhs );
-        Value* rhs = __getRegister( state, cond_rhs );
+        Value* lhs = VM_REG( cond_lhs );
+        Value* rhs = VM_REG( cond_rhs );
 
         if XVM_UNLIKELY ( lhs == rhs || __compareValue( lhs, rhs ) ) {
-          state->pc += offset;
-          goto dispatch;
+          VM_JUMP( offset );
         }
       }
 
@@ -823,21 +1011,19 @@ dispatch:
     }
 
     VM_CASE( JMPIFNEQ ) {
-      uint16_t cond_lhs = state->pc->a;
-      uint16_t cond_rhs = state->pc->b;
-      int16_t offset = state->pc->c;
+      uint16_t cond_lhs = pc->a;
+      uint16_t cond_rhs = pc->b;
+      int16_t offset = pc->c;
 
       if XVM_LIKELY ( cond_lhs != cond_rhs ) {
-        state->pc += offset;
-        goto dispatch;
+        VM_JUMP( offset );
       }
       else {
-        Value* lhs = __getRegister( state, cond_lhs );
-        Value* rhs = __getRegister( state, cond_rhs );
+        Value* lhs = VM_REG( cond_lhs );
+        Value* rhs = VM_REG( cond_rhs );
 
         if XVM_LIKELY ( lhs != rhs || !__compareValue( lhs, rhs ) ) {
-          state->pc += offset;
-          goto dispatch;
+          VM_JUMP( offset );
         }
       }
 
@@ -845,38 +1031,39 @@ dispatch:
     }
 
     VM_CASE( JMPIFLT ) {
-      uint16_t cond_lhs = state->pc->a;
-      uint16_t cond_rhs = state->pc->b;
-      int16_t offset = state->pc->c;
-
-      Value* lhs = __getRegister( state, cond_lhs );
-      Value* rhs = __getRegister( state, cond_rhs );
-
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.i < rhs->u.i ) {
-            state->pc += offset;
-            goto dispatch;
+      uint16_t cond_lhs = pc->a;
+      uint16_t cond_rhs = pc->b;
+      int16_t offset = pc->c;
+
+      Value* lhs = VM_REG( cond_lhs );
+      Value* rhs = VM_REG( cond_rhs );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
+
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
+
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asInt() < rhs->asInt() ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( static_cast<float>( lhs->u.i ) < rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( static_cast<Real>( lhs->asInt() ) < rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.f < static_cast<float>( rhs->u.i ) ) {
-            state->pc += offset;
-            goto dispatch;
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asFloat() < static_cast<Real>( rhs->asInt() ) ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( lhs->u.f < rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( lhs->asFloat() < rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
@@ -885,38 +1072,39 @@ dispatch:
     }
 
     VM_CASE( JMPIFGT ) {
-      uint16_t cond_lhs = state->pc->a;
-      uint16_t cond_rhs = state->pc->b;
-      int16_t offset = state->pc->c;
-
-      Value* lhs = __getRegister( state, cond_lhs );
-      Value* rhs = __getRegister( state, cond_rhs );
-
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.i > rhs->u.i ) {
-            state->pc += offset;
-            goto dispatch;
+      uint16_t cond_lhs = pc->a;
+      uint16_t cond_rhs = pc->b;
+      int16_t offset = pc->c;
+
+      Value* lhs = VM_REG( cond_lhs );
+      Value* rhs = VM_REG( cond_rhs );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
+
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
+
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asInt() > rhs->asInt() ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( static_cast<float>( lhs->u.i ) > rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( static_cast<Real>( lhs->asInt() ) > rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.f > static_cast<float>( rhs->u.i ) ) {
-            state->pc += offset;
-            goto dispatch;
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asFloat() > static_cast<Real>( rhs->asInt() ) ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( lhs->u.f > rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( lhs->asFloat() > rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
@@ -925,38 +1113,39 @@ dispatch:
     }
 
     VM_CASE( JMPIFLTEQ ) {
-      uint16_t cond_lhs = state->pc->a;
-      uint16_t cond_rhs = state->pc->b;
-      int16_t offset = state->pc->c;
-
-      Value* lhs = __getRegister( state, cond_lhs );
-      Value* rhs = __getRegister( state, cond_rhs );
-
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.i <= rhs->u.i ) {
-            state->pc += offset;
-            goto dispatch;
+      uint16_t cond_lhs = pc->a;
+      uint16_t cond_rhs = pc->b;
+      int16_t offset = pc->c;
+
+      Value* lhs = VM_REG( cond_lhs );
+      Value* rhs = VM_REG( cond_rhs );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
+
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
+
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asInt() <= rhs->asInt() ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( static_cast<float>( lhs->u.i ) <= rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( static_cast<Real>( lhs->asInt() ) <= rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.f <= static_cast<float>( rhs->u.i ) ) {
-            state->pc += offset;
-            goto dispatch;
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asFloat() <= static_cast<Real>( rhs->asInt() ) ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( lhs->u.f <= rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( lhs->asFloat() <= rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
@@ -965,38 +1154,39 @@ dispatch:
     }
 
     VM_CASE( JMPIFGTEQ ) {
-      uint16_t cond_lhs = state->pc->a;
-      uint16_t cond_rhs = state->pc->b;
-      int16_t offset = state->pc->c;
-
-      Value* lhs = __getRegister( state, cond_lhs );
-      Value* rhs = __getRegister( state, cond_rhs );
-
-      if XVM_LIKELY ( lhs->type == ValueKind::Int ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.i >= rhs->u.i ) {
-            state->pc += offset;
-            goto dispatch;
+      uint16_t cond_lhs = pc->a;
+      uint16_t cond_rhs = pc->b;
+      int16_t offset = pc->c;
+
+      Value* lhs = VM_REG( cond_lhs );
+      Value* rhs = VM_REG( cond_rhs );
+      Opcode qop = getQuickenedOpcode( pc->op, lhs->kind(), rhs->kind() );
+
+      if ( qop != NOP ) {
+        VM_QUICKEN( qop );
+      }
+
+      if XVM_LIKELY ( lhs->kind() == ValueKind::Int ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asInt() >= rhs->asInt() ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( static_cast<float>( lhs->u.i ) >= rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( static_cast<Real>( lhs->asInt() ) >= rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
-      else if XVM_UNLIKELY ( lhs->type == ValueKind::Float ) {
-        if XVM_LIKELY ( rhs->type == ValueKind::Int ) {
-          if ( lhs->u.f >= static_cast<float>( rhs->u.i ) ) {
-            state->pc += offset;
-            goto dispatch;
+      else if XVM_UNLIKELY ( lhs->kind() == ValueKind::Float ) {
+        if XVM_LIKELY ( rhs->kind() == ValueKind::Int ) {
+          if ( lhs->asFloat() >= static_cast<Real>( rhs->asInt() ) ) {
+            VM_JUMP( offset );
           }
         }
-        else if XVM_UNLIKELY ( rhs->type == ValueKind::Float ) {
-          if ( lhs->u.f >= rhs->u.f ) {
-            state->pc += offset;
-            goto dispatch;
+        else if XVM_UNLIKELY ( rhs->kind() == ValueKind::Float ) {
+          if ( lhs->asFloat() >= rhs->asFloat() ) {
+            VM_JUMP( offset );
           }
         }
       }
@@ -1005,248 +1195,543 @@ dispatch:
     }
 
     VM_CASE( CALL ) {
-      uint16_t fn = state->pc->a;
+      uint16_t fn = pc->a;
 
-      Value* fn_val = __getRegister( state, fn );
+      uint16_t ap = pc->b;
 
-      __call( state, fn_val->u.clsr );
+      Value* fn_val = VM_REG( fn );
 
-      if constexpr ( SingleStep )
-        goto exit;
-      else
-        goto dispatch;
+      // Arguments are passed in place; the callee window starts at register ap, so registers from
+      // ap onwards do not survive the call.
+      VM_SAVE();
+      __call( state, fn_val->asClosure(), ap );
+      VM_LOAD();
+
+      // Calls are the only way for errors to be raised outside of this function (by native
+      // functions or call stack overflows), so this is the only place that needs to poll for them.
+      if XVM_UNLIKELY ( __echeck( state ) ) {
+        goto error;
+      }
+
+      VM_DISPATCH();
     }
 
     VM_CASE( PCALL ) {
-      uint16_t fn = state->pc->a;
-      uint16_t ap = state->pc->b;
-      uint16_t rr = state->pc->c;
+      uint16_t fn = pc->a;
+      uint16_t ap = pc->b;
 
-      Value* fn_val = __getRegister( state, fn );
+      Value* fn_val = VM_REG( fn );
 
-      __pcall( state, fn_val->u.clsr );
+      VM_SAVE();
+      __pcall( state, fn_val->asClosure(), ap );
+      VM_LOAD();
 
-      if constexpr ( SingleStep )
-        goto exit;
-      else
-        goto dispatch;
+      // Calls are the only way for errors to be raised outside of this function (by native
+      // functions or call stack overflows), so this is the only place that needs to poll for them.
+      if XVM_UNLIKELY ( __echeck( state ) ) {
+        goto error;
+      }
+
+      VM_DISPATCH();
+    }
+
+    VM_CASE( TAILCALL ) {
+      uint16_t fn = pc->a;
+      uint16_t ap = pc->b;
+
+      Value* fn_val = VM_REG( fn );
+      bool native = fn_val->asClosure()->callee.type == CallableKind::Native;
+
+      VM_SAVE();
+      __tailcall( state, fn_val->asClosure(), ap );
+      VM_LOAD();
+
+      if XVM_UNLIKELY ( __echeck( state ) ) {
+        goto error;
+      }
+
+      // Native callees have already returned from the reused frame to its caller.
+      if ( native ) {
+        VM_CHECK_RETURN();
+        VM_NEXT();
+      }
+
+      VM_DISPATCH();
     }
 
     VM_CASE( RETNIL ) {
-      __closeClosureUpvs( ( state->callInfoTop - 1 )->closure );
+      VM_SAVE();
+      __closeClosureUpvs( state, ( state->callInfoTop - 1 )->closure );
       __return( state, XVM_NIL );
+      VM_LOAD();
 
       VM_CHECK_RETURN();
       VM_NEXT();
     }
 
     VM_CASE( RETBT ) {
+      VM_SAVE();
       __return( state, Value( true ) );
+      VM_LOAD();
 
       VM_CHECK_RETURN();
       VM_NEXT();
     }
 
     VM_CASE( RETBF ) {
+      VM_SAVE();
       __return( state, Value( false ) );
+      VM_LOAD();
 
       VM_CHECK_RETURN();
       VM_NEXT();
     }
 
     VM_CASE( RET ) {
-      uint16_t ra = state->pc->a;
-      Value* val = __getRegister( state, ra );
+      uint16_t ra = pc->a;
+      Value* val = VM_REG( ra );
 
+      VM_SAVE();
       __return( state, std::move( *val ) );
+      VM_LOAD();
 
       VM_CHECK_RETURN();
       VM_NEXT();
     }
 
     VM_CASE( GETARR ) {
-      uint16_t ra = state->pc->a;
-      uint16_t tbl = state->pc->b;
-      uint16_t key = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+      uint16_t key = pc->c;
+
+      Value* value = VM_REG( tbl );
+      Value* index = VM_REG( key );
+      if ( !__checkArrayIndex( index->asInt() ) ) {
+        VM_ERROR( "array index out of range" );
+      }
 
-      Value* value = __getRegister( state, tbl );
-      Value* index = __getRegister( state, key );
-      Value* result = __getArrayField( value->u.arr, index->u.i );
+      Array* arr = value->asArray();
+      size_t i = index->asInt();
+
+      // Typed arrays load unboxed elements directly
+      if ( arr->kind == ArrayKind::Int && i < arr->size ) {
+        *VM_REG( ra ) = Value( arr->ints[i] );
+      }
+      else if ( arr->kind == ArrayKind::Float && i < arr->size ) {
+        *VM_REG( ra ) = Value( arr->floats[i] );
+      }
+      else {
+        *VM_REG( ra ) = __getArrayField( arr, i );
+      }
 
-      __setRegister( state, ra, __cloneValue( result ) );
       VM_NEXT();
     }
 
     VM_CASE( SETARR ) {
-      uint16_t ra = state->pc->a;
-      uint16_t tbl = state->pc->b;
-      uint16_t key = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+      uint16_t key = pc->c;
+
+      Value* array = VM_REG( tbl );
+      Value* index = VM_REG( key );
+      Value* value = VM_REG( ra );
+      if ( !__checkArrayIndex( index->asInt() ) ) {
+        VM_ERROR( "array index out of range" );
+      }
 
-      Value* array = __getRegister( state, tbl );
-      Value* index = __getRegister( state, key );
-      Value* value = __getRegister( state, ra );
+      Array* arr = __ownArray( state, array );
+      size_t i = index->asInt();
+
+      // Typed arrays overwrite unboxed elements directly when the value matches them
+      if ( arr->kind == ArrayKind::Int && i < arr->size && value->kind() == ValueKind::Int ) {
+        arr->ints[i] = value->asInt();
+        value->setNil();
+      }
+      else if ( arr->kind == ArrayKind::Float && i < arr->size
+                && value->kind() == ValueKind::Float ) {
+        arr->floats[i] = value->asFloat();
+        value->setNil();
+      }
+      else {
+        gcBarrier( state, value );
+        __setArrayField( arr, i, std::move( *value ) );
+      }
 
-      __setArrayField( array->u.arr, index->u.i, std::move( *value ) );
       VM_NEXT();
     }
 
     VM_CASE( NEXTARR ) {
-      static std::unordered_map<void*, uint16_t> next_table;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
+
+      Value* val = VM_REG( rb );
+      Value* cursor = VM_REG( rc );
+      Array* array = val->asArray();
+
+      size_t index = __nextArraySlot( array, __getIterCursor( cursor ) );
+      if ( index < array->size ) {
+        *VM_REG( ra ) = __getArrayField( array, index );
+        *cursor = Value( (Integer)index + 1 );
+      }
+      else {
+        *VM_REG( ra ) = XVM_NIL;
+        *cursor = XVM_NIL;
+      }
+
+      VM_NEXT();
+    }
+
+    VM_CASE( LENARR ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+
+      Value* val = VM_REG( tbl );
+      Integer size = __getArraySize( val->asArray() );
+
+      *VM_REG( ra ) = Value( size );
+      VM_NEXT();
+    }
+
+    VM_CASE( APPENDARR ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+
+      Value* array = VM_REG( tbl );
+      Value* value = VM_REG( ra );
+      if ( __getArraySize( array->asArray() ) >= kArrayMaxSize ) {
+        VM_ERROR( "array size limit exceeded" );
+      }
+
+      Array* arr = __ownArray( state, array );
+      gcBarrier( state, value );
+      __appendArray( arr, std::move( *value ) );
+      VM_NEXT();
+    }
+
+    VM_CASE( POPARR ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
 
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      Value* array = VM_REG( tbl );
 
-      Value* val = __getRegister( state, rb );
-      void* ptr = __toPointer( val );
-      uint16_t key = 0;
+      Array* arr = __ownArray( state, array );
+      *VM_REG( ra ) = __popArray( arr );
+      VM_NEXT();
+    }
+
+    VM_CASE( GETDICT ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+      uint16_t key = pc->c;
+
+      Value* value = VM_REG( tbl );
+      Value* name = VM_REG( key );
+      if ( name->kind() != ValueKind::String ) {
+        VM_ERROR( "dictionary key is not a string" );
+      }
+
+      Value* result =
+        __getDictFieldByKey( state, value->asDict(), name->asString(), VM_FIELD_CACHE() );
+
+      *VM_REG( ra ) = result != NULL ? __cloneValue( result ) : XVM_NIL;
+      VM_NEXT();
+    }
+
+    VM_CASE( SETDICT ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+      uint16_t key = pc->c;
+
+      Value* dict = VM_REG( tbl );
+      Value* name = VM_REG( key );
+      Value* value = VM_REG( ra );
+      if ( name->kind() != ValueKind::String ) {
+        VM_ERROR( "dictionary key is not a string" );
+      }
+
+      Dict* dct = __ownDict( state, dict );
+      gcBarrier( state, value );
+      __setDictFieldByKey( state, dct, name->asString(), std::move( *value ), VM_FIELD_CACHE() );
+      VM_NEXT();
+    }
+
+    VM_CASE( GETDICTK ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+      uint16_t idx = pc->c;
 
-      auto it = next_table.find( ptr );
-      if ( it != next_table.end() ) {
-        key = ++it->second;
+      Value* value = VM_REG( tbl );
+      String* name = __getConstantKey( state, idx );
+      if ( name == NULL ) {
+        VM_ERROR( "dictionary key constant is not a string" );
+      }
+
+      Value* result = __getDictFieldCached( value->asDict(), name, VM_FIELD_CACHE() );
+
+      *VM_REG( ra ) = result != NULL ? __cloneValue( result ) : XVM_NIL;
+      VM_NEXT();
+    }
+
+    VM_CASE( SETDICTK ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
+      uint16_t idx = pc->c;
+
+      Value* dict = VM_REG( tbl );
+      Value* value = VM_REG( ra );
+      String* name = __getConstantKey( state, idx );
+      if ( name == NULL ) {
+        VM_ERROR( "dictionary key constant is not a string" );
+      }
+
+      Dict* dct = __ownDict( state, dict );
+      gcBarrier( state, value );
+      __setDictFieldCached( dct, name, std::move( *value ), VM_FIELD_CACHE() );
+      VM_NEXT();
+    }
+
+    // Yields the value of the next entry in R[a] and its key in R[a + 1].
+    VM_CASE( NEXTDICT ) {
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t rc = pc->c;
+
+      Value* val = VM_REG( rb );
+      Value* cursor = VM_REG( rc );
+      Dict* dict = val->asDict();
+
+      size_t index = __nextDictSlot( dict, __getIterCursor( cursor ) );
+      if ( index < dict->cap ) {
+        *VM_REG( ra ) = __cloneValue( &dict->data[index].value );
+        *VM_REG( ra + 1 ) = __getDictSlotKey( dict, index );
+        *cursor = Value( (Integer)index + 1 );
       }
       else {
-        next_table[ptr] = 0;
+        *VM_REG( ra ) = XVM_NIL;
+        *VM_REG( ra + 1 ) = XVM_NIL;
+        *cursor = XVM_NIL;
       }
 
-      Value* field = __getArrayField( val->u.arr, key );
-      __setRegister( state, ra, __cloneValue( field ) );
       VM_NEXT();
     }
 
-    VM_CASE( LENARR ) {
-      uint16_t ra = state->pc->a;
-      uint16_t tbl = state->pc->b;
+    VM_CASE( LENDICT ) {
+      uint16_t ra = pc->a;
+      uint16_t tbl = pc->b;
 
-      Value* val = __getRegister( state, tbl );
-      int size = __getArraySize( val->u.arr );
+      Value* val = VM_REG( tbl );
+      Integer size = __getDictSize( val->asDict() );
 
-      __setRegister( state, ra, Value( size ) );
+      *VM_REG( ra ) = Value( size );
       VM_NEXT();
     }
 
     VM_CASE( LENSTR ) {
-      uint16_t rdst = state->pc->a;
-      uint16_t objr = state->pc->b;
+      uint16_t rdst = pc->a;
+      uint16_t objr = pc->b;
 
-      Value* val = __getRegister( state, objr );
-      int len = val->u.str->size;
+      Value* val = VM_REG( objr );
+      Integer len = val->asString()->size;
 
-      __setRegister( state, rdst, Value( len ) );
+      *VM_REG( rdst ) = Value( len );
       VM_NEXT();
     }
 
     VM_CASE( CONSTR ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* lhs = __getRegister( state, ra );
-      Value* rhs = __getRegister( state, rb );
+      Value* lhs = VM_REG( ra );
+      Value* rhs = VM_REG( rb );
 
-      String* lstr = lhs->u.str;
-      String* rstr = rhs->u.str;
-      String* str = __concatString( lstr, rstr );
-
-      __setRegister( state, ra, Value( str ) );
+      // Appends in place, copying the left string first if it is shared
+      __appendString( __ownString( lhs ), rhs->asString() );
       VM_NEXT();
     }
 
     VM_CASE( GETSTR ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
-      uint16_t ic = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
+      uint16_t ic = pc->c;
 
-      Value* val = __getRegister( state, ra );
-      String* str = val->u.str;
+      Value* val = VM_REG( ra );
+      String* str = val->asString();
       if ( ic + 1 > str->size ) {
         VM_ERROR( "string index out of range" );
       }
 
-      char chr = __getString( str, ic );
-
-      TempBuf<char> buf( 2 );
-      buf.data[0] = chr;
-      buf.data[1] = '\0';
+      char buf[2] = { __getString( str, ic ), '\0' };
 
-      __setRegister( state, rb, Value( buf.data ) );
+      *VM_REG( rb ) = Value( buf );
       VM_NEXT();
     }
 
     VM_CASE( SETSTR ) {
-      uint16_t ra = state->pc->a;
-      uint16_t cb = state->pc->b;
-      uint16_t ic = state->pc->c;
+      uint16_t ra = pc->a;
+      uint16_t cb = pc->b;
+      uint16_t ic = pc->c;
 
-      Value* val = __getRegister( state, ra );
-      String* str = val->u.str;
-      if ( ic + 1 > str->size ) {
+      Value* val = VM_REG( ra );
+      if ( ic + 1 > val->asString()->size ) {
         VM_ERROR( "string index out of range" );
       }
 
-      __setString( str, ic, (char)cb );
+      __setString( __ownString( val ), ic, (char)cb );
       VM_NEXT();
     }
 
     VM_CASE( ICAST ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* target = __getRegister( state, rb );
+      Value* target = VM_REG( rb );
 
       bool fail;
-      int result = __toInt( target, &fail );
+      Integer result = __toInt( target, &fail );
 
       if ( fail ) {
         VM_ERROR( "Integer cast failed" );
       }
 
-      __setRegister( state, ra, Value( result ) );
+      *VM_REG( ra ) = Value( result );
       VM_NEXT();
     }
 
     VM_CASE( FCAST ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* target = __getRegister( state, rb );
+      Value* target = VM_REG( rb );
 
       bool fail;
-      float result = __toFloat( target, &fail );
+      Real result = __toFloat( target, &fail );
 
       if ( fail ) {
         VM_ERROR( "Float cast failed" );
       }
 
-      __setRegister( state, ra, Value( result ) );
+      *VM_REG( ra ) = Value( result );
       VM_NEXT();
     }
 
     VM_CASE( STRCAST ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* target = __getRegister( state, rb );
+      Value* target = VM_REG( rb );
       auto result = __toString( target );
 
-      __setRegister( state, ra, Value( new String( result.c_str() ) ) );
+      *VM_REG( ra ) = Value( new String( result.c_str() ) );
       VM_NEXT();
     }
 
     VM_CASE( BCAST ) {
-      uint16_t ra = state->pc->a;
-      uint16_t rb = state->pc->b;
+      uint16_t ra = pc->a;
+      uint16_t rb = pc->b;
 
-      Value* target = __getRegister( state, rb );
+      Value* target = VM_REG( rb );
       auto result = __toString( target );
 
-      __setRegister( state, ra, Value( new String( result.c_str() ) ) );
-      VM_NEXT();
-    }
+      *VM_REG( ra ) = Value( new String( result.c_str() ) );
+      VM_NEXT();
+    }
+
+    VM_QUICK_ARITH( ADDII, ADD, Int )
+    VM_QUICK_ARITH( ADDFF, ADD, Float )
+    VM_QUICK_ARITH( SUBII, SUB, Int )
+    VM_QUICK_ARITH( SUBFF, SUB, Float )
+    VM_QUICK_ARITH( MULII, MUL, Int )
+    VM_QUICK_ARITH( MULFF, MUL, Float )
+    VM_QUICK_ARITH( DIVII, DIV, Int )
+    VM_QUICK_ARITH( DIVFF, DIV, Float )
+    VM_QUICK_ARITH( MODII, MOD, Int )
+    VM_QUICK_ARITH( MODFF, MOD, Float )
+    VM_QUICK_ARITH( POWII, POW, Int )
+    VM_QUICK_ARITH( POWFF, POW, Float )
+
+    VM_QUICK_COMPARE( LTII, LT, Int, < )
+    VM_QUICK_COMPARE( LTFF, LT, Float, < )
+    VM_QUICK_COMPARE( GTII, GT, Int, > )
+    VM_QUICK_COMPARE( GTFF, GT, Float, > )
+    VM_QUICK_COMPARE( LTEQII, LTEQ, Int, <= )
+    VM_QUICK_COMPARE( LTEQFF, LTEQ, Float, <= )
+    VM_QUICK_COMPARE( GTEQII, GTEQ, Int, >= )
+    VM_QUICK_COMPARE( GTEQFF, GTEQ, Float, >= )
+
+    VM_QUICK_JUMP( JMPIFLTII, JMPIFLT, Int, < )
+    VM_QUICK_JUMP( JMPIFLTFF, JMPIFLT, Float, < )
+    VM_QUICK_JUMP( JMPIFGTII, JMPIFGT, Int, > )
+    VM_QUICK_JUMP( JMPIFGTFF, JMPIFGT, Float, > )
+    VM_QUICK_JUMP( JMPIFLTEQII, JMPIFLTEQ, Int, <= )
+    VM_QUICK_JUMP( JMPIFLTEQFF, JMPIFLTEQ, Float, <= )
+    VM_QUICK_JUMP( JMPIFGTEQII, JMPIFGTEQ, Int, >= )
+    VM_QUICK_JUMP( JMPIFGTEQFF, JMPIFGTEQ, Float, >= )
+
+#define XVM_SUPERINSN_HANDLERS
+#include "xvm_superinsn.h"
+#undef XVM_SUPERINSN_HANDLERS
   }
 
-exit:;
+  // Errors never fall through to the dispatch path; every site that can raise one diverts here
+  // directly with the state spilled.
+  // The __ehandle function works by unwinding the stack until
+  // either hitting a stack frame flagged as error handler, or, the root
+  // stack frame, and the root stack frame cannot be an error handler
+  // under any circumstances. Therefore the error will act as a fatal
+  // error, being automatically thrown by __ehandle, along with a
+  // cstk and debug information.
+error:
+  if ( __ehandle( state ) ) {
+    VM_LOAD();
+    VM_DISPATCH();
+  }
+
+  VM_LOAD();
+
+exit:
+  VM_SAVE();
+}
+
+#if XVM_JIT
+// Runs compiled code of the executing function, and steps the interpreter over every instruction
+// compiled code leaves to it (calls, returns, errors and unsupported opcodes), until execution
+// finishes the same way it would in the interpreter.
+static void executeJit( State* state ) {
+  while ( true ) {
+    const Callable& callee = ( state->callInfoTop - 1 )->closure->callee;
+
+    if ( callee.type == CallableKind::Function ) {
+      const Function& fn = callee.u.fn;
+      const JitFunction* jfn = jitCompile( state, fn );
+
+      if ( jfn != NULL && state->pc >= fn.code && state->pc < fn.code + fn.size ) {
+        jitRun( state, jfn );
+      }
+    }
+
+    if ( state->pc->op == EXIT ) {
+      break;
+    }
+
+    execute<true, false>( state );
+
+    // Returned from the root frame, or unwound it with an unhandled error.
+    if ( state->callInfoTop == state->callInfoStack.data ) {
+      break;
+    }
+  }
 }
+#endif
 
 void execute( State& state ) {
+#if XVM_JIT
+  if ( state.jit ) {
+    executeJit( &state );
+    return;
+  }
+#endif
+
   execute<false, false>( &state );
 }
 
@@ -0,0 +1,354 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+#include "xvm_gc.h"
+#include "xvm_state.h"
+#include "xvm_array.h"
+#include "xvm_dict.h"
+#include "xvm_closure.h"
+#include "xvm_api_impl.h"
+
+namespace xvm {
+
+GcObject::~GcObject() {
+  if ( gcNext != NULL ) {
+    gcPrev->gcNext = gcNext;
+    gcNext->gcPrev = gcPrev;
+  }
+}
+
+GcHeap::GcHeap() {
+  objects.gcNext = &objects;
+  objects.gcPrev = &objects;
+}
+
+static void link( GcObject* obj, GcObject* after ) {
+  obj->gcPrev = after;
+  obj->gcNext = after->gcNext;
+  after->gcNext->gcPrev = obj;
+  after->gcNext = obj;
+}
+
+static void unlink( GcObject* obj ) {
+  obj->gcPrev->gcNext = obj->gcNext;
+  obj->gcNext->gcPrev = obj->gcPrev;
+  obj->gcNext = NULL;
+  obj->gcPrev = NULL;
+}
+
+// Returns the header of the object held by a value, or NULL if it does not hold a container.
+// Strings cannot reference other objects, so they never take part in cycles and are not tracked.
+static GcObject* toObject( const Value* val ) {
+  using enum ValueKind;
+
+  switch ( val->kind() ) {
+  case Array:
+    return val->asArray();
+  case Dict:
+    return val->asDict();
+  case Function:
+    return val->asClosure();
+  default:
+    return NULL;
+  }
+}
+
+// Untracked objects (e.g. containers built through the API) are never swept, but may hold tracked
+// ones, so their contents are marked too. They are retained until marking ends, when they are
+// whitened again.
+static void shadeObject( GcHeap& heap, GcObject* obj, ValueKind kind ) {
+  if ( obj == NULL || obj->gcColor != GcColor::White ) {
+    return;
+  }
+
+  obj->gcColor = GcColor::Gray;
+  heap.grayStack.push_back( obj );
+
+  if ( obj->gcNext == NULL ) {
+    obj->gcKind = kind;
+    obj->refCount++;
+    heap.untracked.push_back( obj );
+  }
+}
+
+static void shade( GcHeap& heap, const Value* val ) {
+  shadeObject( heap, toObject( val ), val->kind() );
+}
+
+// Frees a tracked or reached object by its kind.
+static void freeObject( GcObject* obj ) {
+  using enum ValueKind;
+
+  switch ( obj->gcKind ) {
+  case Array:
+    delete static_cast<struct Array*>( obj );
+    break;
+  case Dict:
+    delete static_cast<struct Dict*>( obj );
+    break;
+  case Function:
+    delete static_cast<Closure*>( obj );
+    break;
+  default:
+    XVM_UNREACHABLE();
+  }
+}
+
+// Shades the contents of an object; returns the number of values visited.
+static size_t traceObject( GcHeap& heap, GcObject* obj ) {
+  using enum ValueKind;
+
+  switch ( obj->gcKind ) {
+  case Array: {
+    struct Array* array = static_cast<struct Array*>( obj );
+    if ( array->kind != ArrayKind::Generic ) {
+      return 0;
+    }
+
+    for ( size_t i = 0; i < array->size; i++ ) {
+      shade( heap, array->data + i );
+    }
+
+    return array->size;
+  }
+  case Dict: {
+    struct Dict* dict = static_cast<struct Dict*>( obj );
+    for ( size_t i = 0; i < dict->cap; i++ ) {
+      shade( heap, &dict->data[i].value );
+    }
+
+    return dict->cap;
+  }
+  case Function: {
+    Closure* closure = static_cast<Closure*>( obj );
+    for ( size_t i = 0; i < closure->upvs.size; i++ ) {
+      UpValue* upv = closure->upvs.data + i;
+      if ( upv->valid && upv->value != NULL ) {
+        shade( heap, upv->value );
+      }
+
+      shade( heap, &upv->heap );
+    }
+
+    return closure->upvs.size;
+  }
+  default:
+    XVM_UNREACHABLE();
+  }
+
+  return 0;
+}
+
+// Releases the contents of an object.
+static void clearObject( GcObject* obj ) {
+  using enum ValueKind;
+
+  switch ( obj->gcKind ) {
+  case Array: {
+    struct Array* array = static_cast<struct Array*>( obj );
+    if ( array->kind == ArrayKind::Generic ) {
+      for ( size_t i = 0; i < array->size; i++ ) {
+        impl::__resetValue( array->data + i );
+      }
+    }
+
+    array->size = 0;
+    break;
+  }
+  case Dict: {
+    struct Dict* dict = static_cast<struct Dict*>( obj );
+    for ( size_t i = 0; i < dict->cap; i++ ) {
+      impl::__resetValue( &dict->data[i].value );
+    }
+
+    break;
+  }
+  case Function: {
+    Closure* closure = static_cast<Closure*>( obj );
+    for ( size_t i = 0; i < closure->upvs.size; i++ ) {
+      impl::__resetValue( &closure->upvs.data[i].heap );
+    }
+
+    break;
+  }
+  default:
+    XVM_UNREACHABLE();
+  }
+}
+
+// Shades every value the state references directly. Registers and stack slots above the current
+// tops are stale, and not considered.
+static void markRoots( State* state ) {
+  GcHeap& heap = state->gc;
+
+  for ( Value* val = state->registers.data; val < state->regTop; val++ ) {
+    shade( heap, val );
+  }
+
+  for ( Value* val = state->stack.data; val < state->stackTop; val++ ) {
+    shade( heap, val );
+  }
+
+  for ( CallInfo* ci = state->callInfoStack.data; ci < state->callInfoTop; ci++ ) {
+    shadeObject( heap, ci->closure, ValueKind::Function );
+  }
+
+  if ( state->globalEnv != NULL ) {
+    for ( size_t i = 0; i < state->globalEnv->cap; i++ ) {
+      shade( heap, &state->globalEnv->data[i].value );
+    }
+  }
+
+  for ( const Value& k : state->kHolder ) {
+    shade( heap, &k );
+  }
+
+  shade( heap, &state->main );
+}
+
+// Marks gray objects until the gray stack is empty or the budget is spent; returns the remaining
+// budget. Objects whose last reference was released while they were gray are freed here, as the
+// gray stack still pointed to them.
+static size_t propagate( GcHeap& heap, size_t budget ) {
+  while ( budget > 0 && !heap.grayStack.empty() ) {
+    GcObject* obj = heap.grayStack.back();
+    heap.grayStack.pop_back();
+
+    if ( obj->refCount == 0 ) {
+      freeObject( obj );
+      budget--;
+      continue;
+    }
+
+    obj->gcColor = GcColor::Black;
+    budget -= std::min( traceObject( heap, obj ) + 1, budget );
+  }
+
+  return budget;
+}
+
+// Finishes marking atomically. Roots are not covered by the write barrier, so they are marked
+// again to catch objects stored into them since the cycle started.
+static void finishMark( State* state ) {
+  GcHeap& heap = state->gc;
+
+  markRoots( state );
+  propagate( heap, SIZE_MAX );
+
+  for ( GcObject* obj : heap.untracked ) {
+    obj->gcColor = GcColor::White;
+    if ( --obj->refCount == 0 ) {
+      freeObject( obj );
+    }
+  }
+
+  heap.untracked.clear();
+
+  heap.phase = GcPhase::Sweep;
+  heap.survivors = 0;
+  link( &heap.sweepCursor, &heap.objects );
+}
+
+// Breaks the cycles an unreached object takes part in by releasing its contents. The object
+// itself is freed once its last reference is released, which happens at the latest when the
+// unreached objects referencing it are swept.
+static void releaseObject( GcObject* obj ) {
+  obj->refCount++;
+  clearObject( obj );
+
+  if ( --obj->refCount == 0 ) {
+    freeObject( obj );
+  }
+}
+
+// Sweeps objects until reaching the end of the object list or spending the budget. Objects tracked
+// during the sweep are linked before the cursor, and are not swept until the next cycle.
+static void sweep( GcHeap& heap, size_t budget ) {
+  while ( budget-- > 0 ) {
+    GcObject* obj = heap.sweepCursor.gcNext;
+    if ( obj == &heap.objects ) {
+      unlink( &heap.sweepCursor );
+
+      heap.phase = GcPhase::Idle;
+      heap.threshold = std::max( kGcMinThreshold, heap.survivors );
+      return;
+    }
+
+    // Move the cursor past the object first, as releasing it may free the objects around it.
+    unlink( &heap.sweepCursor );
+    link( &heap.sweepCursor, obj );
+
+    if ( obj->gcColor == GcColor::Black ) {
+      obj->gcColor = GcColor::White;
+      heap.survivors++;
+    }
+    else {
+      releaseObject( obj );
+    }
+  }
+}
+
+static void step( State* state, size_t budget ) {
+  GcHeap& heap = state->gc;
+
+  if ( heap.phase == GcPhase::Idle ) {
+    heap.phase = GcPhase::Mark;
+    heap.allocated = 0;
+    markRoots( state );
+  }
+
+  if ( heap.phase == GcPhase::Mark ) {
+    budget = propagate( heap, budget );
+    if ( !heap.grayStack.empty() ) {
+      return;
+    }
+
+    finishMark( state );
+  }
+
+  sweep( heap, budget );
+}
+
+void gcTrack( State* state, GcObject* obj, ValueKind kind ) {
+  GcHeap& heap = state->gc;
+
+  obj->gcKind = kind;
+  obj->gcColor = GcColor::White;
+  link( obj, &heap.objects );
+
+  heap.allocated++;
+  heap.debt++;
+}
+
+void gcCheck( State* state ) {
+  GcHeap& heap = state->gc;
+
+  bool due =
+    heap.phase == GcPhase::Idle ? heap.allocated >= heap.threshold : heap.debt >= kGcStepInterval;
+  if ( due ) {
+    heap.debt = 0;
+    step( state, heap.stepBudget );
+  }
+}
+
+void gcStep( State* state ) {
+  step( state, state->gc.stepBudget );
+}
+
+void gcCollect( State* state ) {
+  // A cycle in progress may have marked objects that became garbage since it started, so it is
+  // finished before running a full one.
+  if ( state->gc.phase != GcPhase::Idle ) {
+    step( state, SIZE_MAX );
+  }
+
+  step( state, SIZE_MAX );
+}
+
+void gcBarrier( State* state, const Value* val ) {
+  if ( state->gc.phase == GcPhase::Mark ) {
+    shade( state->gc, val );
+  }
+}
+
+} // namespace xvm
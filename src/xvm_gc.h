@@ -0,0 +1,141 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+/**
+ * @file gc.h
+ * @brief Declares the heap object header and the incremental cycle collector.
+ *
+ * Heap objects are owned through reference counts, which free most garbage as soon as its last
+ * reference is released. References that form cycles keep each other alive, so containers created
+ * by a state are also tracked by an incremental mark-sweep collector. The collector marks every
+ * tracked object reachable from the roots of the state, and breaks the cycles of the rest by
+ * releasing their contents. Work is split into steps that visit a bounded number of values, so
+ * the pause of a step does not grow with the heap.
+ */
+#ifndef XVM_GC_H
+#define XVM_GC_H
+
+#include "xvm_common.h"
+#include "xvm_value.h"
+#include "xvm_allocator.h"
+
+/**
+ * @namespace xvm
+ * @ingroup xvm_namespace
+ * @{
+ */
+namespace xvm {
+
+inline constexpr size_t kGcStepBudget = 1024;  ///< Default number of values visited per step.
+inline constexpr size_t kGcStepInterval = 16;  ///< Allocations between steps of a cycle.
+inline constexpr size_t kGcMinThreshold = 256; ///< Minimum allocations between two cycles.
+
+/**
+ * @enum GcColor
+ * @brief Marking state of a tracked object.
+ */
+enum class GcColor : uint8_t {
+  White, ///< Not reached yet; unreached objects are garbage at the end of marking.
+  Gray,  ///< Reached, but its contents are not marked yet.
+  Black, ///< Reached, and its contents are marked.
+};
+
+/**
+ * @enum GcPhase
+ * @brief Phase of the current collection cycle.
+ */
+enum class GcPhase : uint8_t {
+  Idle,  ///< No cycle in progress.
+  Mark,  ///< Marking objects reachable from the roots.
+  Sweep, ///< Releasing unreached objects.
+};
+
+/**
+ * @struct GcObject
+ * @brief Header of reference counted heap objects.
+ *
+ * Tracked objects are linked into the object list of the heap of their state, and unlink
+ * themselves when freed. Copies of an object start with a single reference and are not tracked.
+ */
+struct GcObject {
+  size_t refCount = 1;               ///< Number of owning references.
+  GcObject* gcNext = NULL;           ///< Next object in the heap, or NULL if untracked.
+  GcObject* gcPrev = NULL;           ///< Previous object in the heap, or NULL if untracked.
+  ValueKind gcKind = ValueKind::Nil; ///< Kind of the object, used to free it from the heap.
+  GcColor gcColor = GcColor::White;  ///< Marking state.
+
+  // Headers belong to a single object; copies of an object get a header of their own.
+  XVM_NOCOPY( GcObject );
+  XVM_NOMOVE( GcObject );
+
+  GcObject() = default;
+  ~GcObject();
+
+  // Most objects die young, so they are allocated from pools that recycle their memory. Objects
+  // are always freed through their own type, which is what the size passed to delete is.
+  static void* operator new( size_t size ) {
+    return ObjectPool::alloc( size );
+  }
+
+  static void operator delete( void* ptr, size_t size ) {
+    ObjectPool::free( ptr, size );
+  }
+};
+
+/**
+ * @struct GcHeap
+ * @brief Tracked objects and collector state of a state.
+ */
+struct GcHeap {
+  GcObject objects;     ///< Sentinel of the circular list of tracked objects.
+  GcObject sweepCursor; ///< Marks the position of the sweep in the object list.
+
+  std::vector<GcObject*> grayStack; ///< Reached objects whose contents are not marked yet.
+  std::vector<GcObject*> untracked; ///< Reached untracked objects, retained until marking ends.
+
+  GcPhase phase = GcPhase::Idle;      ///< Phase of the current cycle.
+  size_t allocated = 0;               ///< Objects tracked since the last cycle.
+  size_t threshold = kGcMinThreshold; ///< Allocations that start the next cycle.
+  size_t survivors = 0;               ///< Objects that survived the current sweep.
+  size_t debt = 0;                    ///< Allocations since the last step.
+  size_t stepBudget = kGcStepBudget;  ///< Values visited per step; bounds the pause of a step.
+
+  GcHeap();
+
+  XVM_NOCOPY( GcHeap );
+  XVM_NOMOVE( GcHeap );
+};
+
+/**
+ * @brief Starts tracking a container created by the state.
+ */
+void gcTrack( State* state, GcObject* obj, ValueKind kind );
+
+/**
+ * @brief Called after allocations at points where every live value is reachable from the roots.
+ * Starts a cycle once enough objects were allocated, and performs a step of the current one.
+ */
+void gcCheck( State* state );
+
+/**
+ * @brief Performs a step of the current cycle, visiting at most stepBudget values.
+ */
+void gcStep( State* state );
+
+/**
+ * @brief Runs a full cycle, finishing the current one first if there is one.
+ */
+void gcCollect( State* state );
+
+/**
+ * @brief Write barrier; must be called before storing a value into a heap object. While marking,
+ * the stored object is shaded so that it is not missed if it is only referenced by objects whose
+ * contents were already marked.
+ */
+void gcBarrier( State* state, const Value* val );
+
+} // namespace xvm
+
+/** @} */
+
+#endif
@@ -56,6 +56,25 @@ struct alignas( 8 ) Instruction {
   uint16_t c = OPERAND_INVALID; ///< Third operand.
 };
 
+/**
+ * @struct ThreadedInstruction
+ * @brief Pre-decoded form of an `Instruction` executed by the interpreter.
+ *
+ * Bytecode is translated into a stream of threaded instructions once when it is loaded. The
+ * stream is parallel to the original bytecode (same length and indices, so jump offsets carry
+ * over unchanged), and additionally carries the address of the interpreter handler of each
+ * instruction, which removes the dispatch table lookup from every executed instruction.
+ *
+ * `handler` is only used on compilers that support computed gotos, and is left `NULL` otherwise.
+ */
+struct ThreadedInstruction {
+  void* handler = NULL;         ///< Address of the interpreter handler for `op`.
+  Opcode op = Opcode::NOP;      ///< Operation code.
+  uint16_t a = OPERAND_INVALID; ///< First operand.
+  uint16_t b = OPERAND_INVALID; ///< Second operand.
+  uint16_t c = OPERAND_INVALID; ///< Third operand.
+};
+
 } // namespace xvm
 
 /** @} */
@@ -0,0 +1,1223 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+#include "xvm_jit.h"
+
+#if XVM_JIT
+
+#include "xvm_state.h"
+#include "xvm_api.h"
+#include "xvm_api_impl.h"
+#include "xvm_arith.h"
+#include "xvm_string.h"
+#include <span>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace xvm {
+
+using enum Opcode;
+
+// We use implementation functions only in this file.
+using namespace impl;
+
+// Inline stencils operate on the integer payload of values; with 64-bit integers their ALU
+// instructions take a REX.W prefix, which widens them to 64 bits and sign extends immediates.
+static_assert( sizeof( Integer ) == 4 || sizeof( Integer ) == 8, "Unsupported integer width" );
+static constexpr uint8_t kRexInt = sizeof( Integer ) == 8 ? 0x49 : 0x41;
+
+#define JIT_REG( reg ) ( state->regBase + ( reg ) )
+#define JIT_FIELD_CACHE( insn ) ( &state->fieldCache[( insn ) - state->bcHolder.data()] )
+
+// Runtime stubs. Each stub executes a single instruction against the state, and is called from
+// compiled code with the instruction it executes. Stubs of conditional jumps return whether the
+// jump is taken. Stubs of instructions that may raise an error return nonzero, without executing
+// the instruction, to leave it to the interpreter; the return value of every other stub is ignored.
+using JitStub = int ( * )( State*, const Instruction* );
+
+// Compiled code entry point; takes the state, the native address to start at, and the base of the
+// register window.
+using JitEntry = void ( * )( State*, const uint8_t*, Value* );
+
+template<typename Compare>
+static inline XVM_FORCEINLINE bool
+compareNumbers( const Value* lhs, const Value* rhs, bool* result ) {
+  using enum ValueKind;
+
+  Compare cmp;
+
+  if ( lhs->kind() == Int && rhs->kind() == Int ) {
+    *result = cmp( lhs->asInt(), rhs->asInt() );
+  }
+  else if ( lhs->kind() == Int && rhs->kind() == Float ) {
+    *result = cmp( static_cast<Real>( lhs->asInt() ), rhs->asFloat() );
+  }
+  else if ( lhs->kind() == Float && rhs->kind() == Int ) {
+    *result = cmp( lhs->asFloat(), static_cast<Real>( rhs->asInt() ) );
+  }
+  else if ( lhs->kind() == Float && rhs->kind() == Float ) {
+    *result = cmp( lhs->asFloat(), rhs->asFloat() );
+  }
+  else {
+    return false;
+  }
+
+  return true;
+}
+
+static int stubExit( State* state, const Instruction* insn ) {
+  state->pc = insn;
+  return 0;
+}
+
+static int stubArith( State* state, const Instruction* insn ) {
+  arith( insn->op, JIT_REG( insn->a ), JIT_REG( insn->b ) );
+  return 0;
+}
+
+static int stubIArith( State* state, const Instruction* insn ) {
+  Integer imm = decodeIntImmediate( insn->c, insn->b );
+  iarith( insn->op, JIT_REG( insn->a ), imm );
+  return 0;
+}
+
+static int stubFArith( State* state, const Instruction* insn ) {
+  Real imm = decodeFloatImmediate( insn->c, insn->b );
+  farith( insn->op, JIT_REG( insn->a ), imm );
+  return 0;
+}
+
+static int stubNeg( State* state, const Instruction* insn ) {
+  Value* val = JIT_REG( insn->a );
+
+  if ( val->kind() == ValueKind::Int ) {
+    val->setInt( -val->asInt() );
+  }
+  else if ( val->kind() == ValueKind::Float ) {
+    val->setFloat( -val->asFloat() );
+  }
+
+  return 0;
+}
+
+static int stubMov( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = __cloneValue( JIT_REG( insn->b ) );
+  return 0;
+}
+
+static int stubInc( State* state, const Instruction* insn ) {
+  Value* val = JIT_REG( insn->a );
+
+  if ( val->kind() == ValueKind::Int ) {
+    val->setInt( val->asInt() + 1 );
+  }
+  else if ( val->kind() == ValueKind::Float ) {
+    val->setFloat( val->asFloat() + 1 );
+  }
+
+  return 0;
+}
+
+static int stubDec( State* state, const Instruction* insn ) {
+  Value* val = JIT_REG( insn->a );
+
+  if ( val->kind() == ValueKind::Int ) {
+    val->setInt( val->asInt() - 1 );
+  }
+  else if ( val->kind() == ValueKind::Float ) {
+    val->setFloat( val->asFloat() - 1 );
+  }
+
+  return 0;
+}
+
+static int stubLoadK( State* state, const Instruction* insn ) {
+  const Value& kval = __getConstant( state, insn->b );
+  *JIT_REG( insn->a ) = __cloneValue( &kval );
+  return 0;
+}
+
+static int stubLoadNil( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = XVM_NIL;
+  return 0;
+}
+
+static int stubLoadI( State* state, const Instruction* insn ) {
+  Integer imm = decodeIntImmediate( insn->c, insn->b );
+  *JIT_REG( insn->a ) = Value( imm );
+  return 0;
+}
+
+static int stubLoadF( State* state, const Instruction* insn ) {
+  Real imm = decodeFloatImmediate( insn->c, insn->b );
+  *JIT_REG( insn->a ) = Value( imm );
+  return 0;
+}
+
+static int stubLoadBT( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = Value( true );
+  return 0;
+}
+
+static int stubLoadBF( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = Value( false );
+  return 0;
+}
+
+static int stubLoadArr( State* state, const Instruction* insn ) {
+  uint16_t hint = insn->b;
+  uint16_t kind = insn->c;
+
+  size_t capacity = hint != OPERAND_INVALID && hint != 0 ? hint : kArrayCapacity;
+  ArrayKind elems = kind <= (uint16_t)ArrayKind::Float ? (ArrayKind)kind : ArrayKind::Generic;
+
+  Array* array = new Array( capacity, elems );
+  gcTrack( state, array, ValueKind::Array );
+
+  *JIT_REG( insn->a ) = Value( array );
+  gcCheck( state );
+  return 0;
+}
+
+static int stubLoadDict( State* state, const Instruction* insn ) {
+  Dict* dict = new Dict();
+  gcTrack( state, dict, ValueKind::Dict );
+
+  *JIT_REG( insn->a ) = Value( dict );
+  gcCheck( state );
+  return 0;
+}
+
+static int stubGetUpv( State* state, const Instruction* insn ) {
+  UpValue* upv = __getClosureUpv( ( state->callInfoTop - 1 )->closure, insn->b );
+  *JIT_REG( insn->a ) = __cloneValue( upv->value );
+  return 0;
+}
+
+static int stubSetUpv( State* state, const Instruction* insn ) {
+  __setClosureUpv( state, ( state->callInfoTop - 1 )->closure, insn->b, JIT_REG( insn->a ) );
+  return 0;
+}
+
+static int stubPush( State* state, const Instruction* insn ) {
+  *( state->stackTop++ ) = std::move( *JIT_REG( insn->a ) );
+  return 0;
+}
+
+static int stubPushK( State* state, const Instruction* insn ) {
+  *( state->stackTop++ ) = __getConstant( state, insn->a );
+  return 0;
+}
+
+static int stubPushNil( State* state, const Instruction* ) {
+  *( state->stackTop++ ) = XVM_NIL;
+  return 0;
+}
+
+static int stubPushI( State* state, const Instruction* insn ) {
+  Integer imm = decodeIntImmediate( insn->b, insn->a );
+  *( state->stackTop++ ) = Value( imm );
+  return 0;
+}
+
+static int stubPushF( State* state, const Instruction* insn ) {
+  Real imm = decodeFloatImmediate( insn->b, insn->a );
+  *( state->stackTop++ ) = Value( imm );
+  return 0;
+}
+
+static int stubPushBT( State* state, const Instruction* ) {
+  *( state->stackTop++ ) = Value( true );
+  return 0;
+}
+
+static int stubPushBF( State* state, const Instruction* ) {
+  *( state->stackTop++ ) = Value( false );
+  return 0;
+}
+
+static int stubDrop( State* state, const Instruction* ) {
+  __resetValue( --state->stackTop );
+  return 0;
+}
+
+static int stubGetLocal( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = __cloneValue( __getLocal( state, insn->b ) );
+  return 0;
+}
+
+static int stubSetLocal( State* state, const Instruction* insn ) {
+  __setLocal( state, insn->b, std::move( *JIT_REG( insn->a ) ) );
+  return 0;
+}
+
+static int stubGetArg( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = __cloneValue( state->stackBase - insn->b - 1 );
+  return 0;
+}
+
+static int stubGetGlobal( State* state, const Instruction* insn ) {
+  Value* key = JIT_REG( insn->b );
+  Value* global = __getGlobalCached( state, key->asString(), JIT_FIELD_CACHE( insn ) );
+
+  *JIT_REG( insn->a ) = global != NULL ? __cloneValue( global ) : XVM_NIL;
+  return 0;
+}
+
+static int stubSetGlobal( State* state, const Instruction* insn ) {
+  Value* key = JIT_REG( insn->b );
+  __setGlobalCached(
+    state, key->asString(), std::move( *JIT_REG( insn->a ) ), JIT_FIELD_CACHE( insn )
+  );
+  return 0;
+}
+
+static int stubEq( State* state, const Instruction* insn ) {
+  Value* lhs = JIT_REG( insn->b );
+  Value* rhs = JIT_REG( insn->c );
+
+  *JIT_REG( insn->a ) = Value( lhs == rhs || __compareValue( lhs, rhs ) );
+  return 0;
+}
+
+static int stubDeq( State* state, const Instruction* insn ) {
+  Value* lhs = JIT_REG( insn->b );
+  Value* rhs = JIT_REG( insn->c );
+
+  *JIT_REG( insn->a ) = Value( lhs == rhs || __deepCompareValue( lhs, rhs ) );
+  return 0;
+}
+
+static int stubNeq( State* state, const Instruction* insn ) {
+  Value* lhs = JIT_REG( insn->b );
+  Value* rhs = JIT_REG( insn->c );
+
+  *JIT_REG( insn->a ) = Value( lhs != rhs || __compareValue( lhs, rhs ) );
+  return 0;
+}
+
+static int stubAnd( State* state, const Instruction* insn ) {
+  bool cond = __toBool( JIT_REG( insn->b ) ) && __toBool( JIT_REG( insn->c ) );
+  *JIT_REG( insn->a ) = Value( cond );
+  return 0;
+}
+
+static int stubOr( State* state, const Instruction* insn ) {
+  bool cond = __toBool( JIT_REG( insn->b ) ) || __toBool( JIT_REG( insn->c ) );
+  *JIT_REG( insn->a ) = Value( cond );
+  return 0;
+}
+
+static int stubNot( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = Value( !__toBool( JIT_REG( insn->b ) ) );
+  return 0;
+}
+
+template<typename Compare>
+static int stubCompare( State* state, const Instruction* insn ) {
+  bool result;
+
+  if ( compareNumbers<Compare>( JIT_REG( insn->b ), JIT_REG( insn->c ), &result ) ) {
+    *JIT_REG( insn->a ) = Value( result );
+  }
+
+  return 0;
+}
+
+static int stubJmpIf( State* state, const Instruction* insn ) {
+  return __toBool( JIT_REG( insn->a ) );
+}
+
+static int stubJmpIfN( State* state, const Instruction* insn ) {
+  return !__toBool( JIT_REG( insn->a ) );
+}
+
+static int stubJmpIfEq( State* state, const Instruction* insn ) {
+  Value* lhs = JIT_REG( insn->a );
+  Value* rhs = JIT_REG( insn->b );
+
+  return lhs == rhs || __compareValue( lhs, rhs );
+}
+
+static int stubJmpIfNeq( State* state, const Instruction* insn ) {
+  Value* lhs = JIT_REG( insn->a );
+  Value* rhs = JIT_REG( insn->b );
+
+  return lhs != rhs || !__compareValue( lhs, rhs );
+}
+
+template<typename Compare>
+static int stubJmpIfCompare( State* state, const Instruction* insn ) {
+  bool result;
+  return compareNumbers<Compare>( JIT_REG( insn->a ), JIT_REG( insn->b ), &result ) && result;
+}
+
+static int stubGetArr( State* state, const Instruction* insn ) {
+  Value* array = JIT_REG( insn->b );
+  Value* index = JIT_REG( insn->c );
+  if ( !__checkArrayIndex( index->asInt() ) ) {
+    state->pc = insn;
+    return 1;
+  }
+
+  *JIT_REG( insn->a ) = __getArrayField( array->asArray(), index->asInt() );
+  return 0;
+}
+
+static int stubSetArr( State* state, const Instruction* insn ) {
+  Value* array = JIT_REG( insn->b );
+  Value* index = JIT_REG( insn->c );
+
+  Value* value = JIT_REG( insn->a );
+  if ( !__checkArrayIndex( index->asInt() ) ) {
+    state->pc = insn;
+    return 1;
+  }
+
+  Array* arr = __ownArray( state, array );
+  gcBarrier( state, value );
+  __setArrayField( arr, index->asInt(), std::move( *value ) );
+  return 0;
+}
+
+static int stubNextArr( State* state, const Instruction* insn ) {
+  Value* cursor = JIT_REG( insn->c );
+  Array* array = JIT_REG( insn->b )->asArray();
+
+  size_t index = __nextArraySlot( array, __getIterCursor( cursor ) );
+  if ( index < array->size ) {
+    *JIT_REG( insn->a ) = __getArrayField( array, index );
+    *cursor = Value( (Integer)index + 1 );
+  }
+  else {
+    *JIT_REG( insn->a ) = XVM_NIL;
+    *cursor = XVM_NIL;
+  }
+
+  return 0;
+}
+
+static int stubLenArr( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = Value( (Integer)__getArraySize( JIT_REG( insn->b )->asArray() ) );
+  return 0;
+}
+
+static int stubAppendArr( State* state, const Instruction* insn ) {
+  Value* array = JIT_REG( insn->b );
+  Value* value = JIT_REG( insn->a );
+  if ( __getArraySize( array->asArray() ) >= kArrayMaxSize ) {
+    state->pc = insn;
+    return 1;
+  }
+
+  Array* arr = __ownArray( state, array );
+  gcBarrier( state, value );
+  __appendArray( arr, std::move( *value ) );
+  return 0;
+}
+
+static int stubPopArr( State* state, const Instruction* insn ) {
+  Array* arr = __ownArray( state, JIT_REG( insn->b ) );
+
+  *JIT_REG( insn->a ) = __popArray( arr );
+  return 0;
+}
+
+static int stubGetDict( State* state, const Instruction* insn ) {
+  Value* dict = JIT_REG( insn->b );
+  Value* name = JIT_REG( insn->c );
+  if ( name->kind() != ValueKind::String ) {
+    state->pc = insn;
+    return 1;
+  }
+
+  Value* result =
+    __getDictFieldByKey( state, dict->asDict(), name->asString(), JIT_FIELD_CACHE( insn ) );
+
+  *JIT_REG( insn->a ) = result != NULL ? __cloneValue( result ) : XVM_NIL;
+  return 0;
+}
+
+static int stubSetDict( State* state, const Instruction* insn ) {
+  Value* name = JIT_REG( insn->c );
+  Value* value = JIT_REG( insn->a );
+  if ( name->kind() != ValueKind::String ) {
+    state->pc = insn;
+    return 1;
+  }
+
+  Dict* dict = __ownDict( state, JIT_REG( insn->b ) );
+  gcBarrier( state, value );
+  __setDictFieldByKey(
+    state, dict, name->asString(), std::move( *value ), JIT_FIELD_CACHE( insn )
+  );
+  return 0;
+}
+
+static int stubGetDictK( State* state, const Instruction* insn ) {
+  Value* dict = JIT_REG( insn->b );
+  String* name = __getConstantKey( state, insn->c );
+  if ( name == NULL ) {
+    state->pc = insn;
+    return 1;
+  }
+
+  Value* result = __getDictFieldCached( dict->asDict(), name, JIT_FIELD_CACHE( insn ) );
+
+  *JIT_REG( insn->a ) = result != NULL ? __cloneValue( result ) : XVM_NIL;
+  return 0;
+}
+
+static int stubSetDictK( State* state, const Instruction* insn ) {
+  Value* value = JIT_REG( insn->a );
+  String* name = __getConstantKey( state, insn->c );
+  if ( name == NULL ) {
+    state->pc = insn;
+    return 1;
+  }
+
+  Dict* dict = __ownDict( state, JIT_REG( insn->b ) );
+  gcBarrier( state, value );
+  __setDictFieldCached( dict, name, std::move( *value ), JIT_FIELD_CACHE( insn ) );
+  return 0;
+}
+
+static int stubNextDict( State* state, const Instruction* insn ) {
+  Value* cursor = JIT_REG( insn->c );
+  Dict* dict = JIT_REG( insn->b )->asDict();
+
+  size_t index = __nextDictSlot( dict, __getIterCursor( cursor ) );
+  if ( index < dict->cap ) {
+    *JIT_REG( insn->a ) = __cloneValue( &dict->data[index].value );
+    *JIT_REG( insn->a + 1 ) = __getDictSlotKey( dict, index );
+    *cursor = Value( (Integer)index + 1 );
+  }
+  else {
+    *JIT_REG( insn->a ) = XVM_NIL;
+    *JIT_REG( insn->a + 1 ) = XVM_NIL;
+    *cursor = XVM_NIL;
+  }
+
+  return 0;
+}
+
+static int stubLenDict( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = Value( (Integer)__getDictSize( JIT_REG( insn->b )->asDict() ) );
+  return 0;
+}
+
+static int stubLenStr( State* state, const Instruction* insn ) {
+  *JIT_REG( insn->a ) = Value( (Integer)JIT_REG( insn->b )->asString()->size );
+  return 0;
+}
+
+static int stubConStr( State* state, const Instruction* insn ) {
+  Value* lhs = JIT_REG( insn->a );
+  Value* rhs = JIT_REG( insn->b );
+
+  __appendString( __ownString( lhs ), rhs->asString() );
+  return 0;
+}
+
+static int stubStrCast( State* state, const Instruction* insn ) {
+  auto result = __toString( JIT_REG( insn->b ) );
+  *JIT_REG( insn->a ) = Value( new String( result.c_str() ) );
+  return 0;
+}
+
+// Stencils; position independent machine code for x86-64 System V. Compiled code keeps the
+// state in rbx and the register window base in r12, both callee saved, so runtime stubs can be
+// called without spilling anything.
+enum class HoleKind : uint8_t {
+  Insn,   ///< imm64, address of the instruction.
+  Stub,   ///< imm64, address of the runtime stub.
+  TypeA,  ///< disp32, offset of the type of register A.
+  TypeB,  ///< disp32, offset of the type of register B.
+  ValueA, ///< disp32, offset of the payload of register A.
+  ValueB, ///< disp32, offset of the payload of register B.
+  Imm,    ///< imm32, 32-bit immediate stored in operands B and C.
+  Op,     ///< imm8, opcode specific byte of the stencil (ALU operation or condition code).
+  Target, ///< rel32, native address of the jump target.
+  Exit,   ///< rel32, native address of the epilogue.
+};
+
+struct Hole {
+  uint8_t offset;
+  HoleKind kind;
+};
+
+struct Stencil {
+  std::span<const uint8_t> code;
+  std::span<const Hole> holes;
+};
+
+static constexpr uint8_t kInt = (uint8_t)ValueKind::Int;
+
+// clang-format off
+#define JIT_CALL_STUB                                                                              \
+  0x48, 0x89, 0xDF,                         /* mov rdi, rbx           */                           \
+  0x48, 0xBE, 0, 0, 0, 0, 0, 0, 0, 0,       /* mov rsi, insn          */                           \
+  0x48, 0xB8, 0, 0, 0, 0, 0, 0, 0, 0,       /* mov rax, stub          */                           \
+  0xFF, 0xD0                                /* call rax               */
+
+static constexpr uint8_t kPrologue[] = {
+  0x53,                                     // push rbx
+  0x41, 0x54,                               // push r12
+  0x55,                                     // push rbp (stack alignment)
+  0x48, 0x89, 0xFB,                         // mov rbx, rdi
+  0x49, 0x89, 0xD4,                         // mov r12, rdx
+  0xFF, 0xE6,                               // jmp rsi
+};
+
+static constexpr uint8_t kEpilogue[] = {
+  0x5D,                                     // pop rbp
+  0x41, 0x5C,                               // pop r12
+  0x5B,                                     // pop rbx
+  0xC3,                                     // ret
+};
+
+static constexpr uint8_t kCallCode[] = { JIT_CALL_STUB };
+static constexpr Hole kCallHoles[] = { { 5, HoleKind::Insn }, { 15, HoleKind::Stub } };
+
+static constexpr uint8_t kBranchCode[] = {
+  JIT_CALL_STUB,
+  0x85, 0xC0,                               // test eax, eax
+  0x0F, 0x85, 0, 0, 0, 0,                   // jnz target
+};
+static constexpr Hole kBranchHoles[] = {
+  { 5, HoleKind::Insn }, { 15, HoleKind::Stub }, { 29, HoleKind::Target },
+};
+
+static constexpr uint8_t kExitCode[] = {
+  JIT_CALL_STUB,
+  0xE9, 0, 0, 0, 0,                         // jmp epilogue
+};
+static constexpr Hole kExitHoles[] = {
+  { 5, HoleKind::Insn }, { 15, HoleKind::Stub }, { 26, HoleKind::Exit },
+};
+
+// Call of a stub that leaves compiled code, before its instruction, when it returns nonzero.
+static constexpr uint8_t kCallExitCode[] = {
+  JIT_CALL_STUB,
+  0x85, 0xC0,                               // test eax, eax
+  0x0F, 0x85, 0, 0, 0, 0,                   // jnz exit
+};
+static constexpr Hole kCallExitHoles[] = {
+  { 5, HoleKind::Insn }, { 15, HoleKind::Stub }, { 29, HoleKind::Exit },
+};
+
+static constexpr uint8_t kJumpCode[] = {
+  0xE9, 0, 0, 0, 0,                         // jmp target
+};
+static constexpr Hole kJumpHoles[] = { { 1, HoleKind::Target } };
+
+// Integer fast path of IADD/ISUB; op is the ModRM byte selecting the ALU operation.
+static constexpr uint8_t kIntArithImmCode[] = {
+  0x41, 0x80, 0xBC, 0x24, 0, 0, 0, 0, kInt, // cmp byte [r12 + typeA], Int
+  0x75, 0x0E,                               // jne slow
+  kRexInt, 0x81, 0, 0x24, 0, 0, 0, 0,       // <op> dword [r12 + valueA], ...
+  0, 0, 0, 0,                               //   imm
+  0xEB, 0x19,                               // jmp next
+  JIT_CALL_STUB,                            // slow:
+};
+static constexpr Hole kIntArithImmHoles[] = {
+  { 4, HoleKind::TypeA }, { 13, HoleKind::Op },  { 15, HoleKind::ValueA },
+  { 19, HoleKind::Imm },  { 30, HoleKind::Insn }, { 40, HoleKind::Stub },
+};
+
+// Integer fast path of ADD/SUB; op is the ALU opcode.
+static constexpr uint8_t kIntArithCode[] = {
+  0x41, 0x80, 0xBC, 0x24, 0, 0, 0, 0, kInt, // cmp byte [r12 + typeA], Int
+  0x75, 0x1D,                               // jne slow
+  0x41, 0x80, 0xBC, 0x24, 0, 0, 0, 0, kInt, // cmp byte [r12 + typeB], Int
+  0x75, 0x12,                               // jne slow
+  kRexInt, 0x8B, 0x84, 0x24, 0, 0, 0, 0,    // mov eax, [r12 + valueB]
+  kRexInt, 0, 0x84, 0x24, 0, 0, 0, 0,       // <op> [r12 + valueA], eax
+  0xEB, 0x19,                               // jmp next
+  JIT_CALL_STUB,                            // slow:
+};
+static constexpr Hole kIntArithHoles[] = {
+  { 4, HoleKind::TypeA },   { 15, HoleKind::TypeB }, { 26, HoleKind::ValueB },
+  { 31, HoleKind::Op },     { 34, HoleKind::ValueA }, { 45, HoleKind::Insn },
+  { 55, HoleKind::Stub },
+};
+
+// Integer fast path of JMPIFLT/GT/LTEQ/GTEQ; op is the condition code of the jump.
+static constexpr uint8_t kIntBranchCode[] = {
+  0x41, 0x80, 0xBC, 0x24, 0, 0, 0, 0, kInt, // cmp byte [r12 + typeA], Int
+  0x75, 0x23,                               // jne slow
+  0x41, 0x80, 0xBC, 0x24, 0, 0, 0, 0, kInt, // cmp byte [r12 + typeB], Int
+  0x75, 0x18,                               // jne slow
+  kRexInt, 0x8B, 0x84, 0x24, 0, 0, 0, 0,    // mov eax, [r12 + valueA]
+  kRexInt, 0x3B, 0x84, 0x24, 0, 0, 0, 0,    // cmp eax, [r12 + valueB]
+  0x0F, 0, 0, 0, 0, 0,                      // j<op> target
+  0xEB, 0x21,                               // jmp next
+  JIT_CALL_STUB,                            // slow:
+  0x85, 0xC0,                               // test eax, eax
+  0x0F, 0x85, 0, 0, 0, 0,                   // jnz target
+};
+static constexpr Hole kIntBranchHoles[] = {
+  { 4, HoleKind::TypeA },   { 15, HoleKind::TypeB }, { 26, HoleKind::ValueA },
+  { 34, HoleKind::ValueB }, { 39, HoleKind::Op },     { 40, HoleKind::Target },
+  { 51, HoleKind::Insn },   { 61, HoleKind::Stub },   { 75, HoleKind::Target },
+};
+
+// Trace stencils. Traces specialize instructions for the operand types observed while recording,
+// and leave through a side exit when a guard fails instead of taking a slow path.
+static constexpr uint8_t kGuardIntACode[] = {
+  0x41, 0x80, 0xBC, 0x24, 0, 0, 0, 0, kInt, // cmp byte [r12 + typeA], Int
+  0x0F, 0x85, 0, 0, 0, 0,                   // jne exit
+};
+static constexpr Hole kGuardIntAHoles[] = { { 4, HoleKind::TypeA }, { 11, HoleKind::Exit } };
+
+static constexpr uint8_t kGuardIntBCode[] = {
+  0x41, 0x80, 0xBC, 0x24, 0, 0, 0, 0, kInt, // cmp byte [r12 + typeB], Int
+  0x0F, 0x85, 0, 0, 0, 0,                   // jne exit
+};
+static constexpr Hole kGuardIntBHoles[] = { { 4, HoleKind::TypeB }, { 11, HoleKind::Exit } };
+
+static constexpr uint8_t kIntImmCode[] = {
+  kRexInt, 0x81, 0, 0x24, 0, 0, 0, 0,       // <op> dword [r12 + valueA], ...
+  0, 0, 0, 0,                               //   imm
+};
+static constexpr Hole kIntImmHoles[] = {
+  { 2, HoleKind::Op }, { 4, HoleKind::ValueA }, { 8, HoleKind::Imm },
+};
+
+static constexpr uint8_t kIntRegCode[] = {
+  kRexInt, 0x8B, 0x84, 0x24, 0, 0, 0, 0,    // mov eax, [r12 + valueB]
+  kRexInt, 0, 0x84, 0x24, 0, 0, 0, 0,       // <op> [r12 + valueA], eax
+};
+static constexpr Hole kIntRegHoles[] = {
+  { 4, HoleKind::ValueB }, { 9, HoleKind::Op }, { 12, HoleKind::ValueA },
+};
+
+static constexpr uint8_t kIntUnaryCode[] = {
+  kRexInt, 0xFF, 0, 0x24, 0, 0, 0, 0,       // inc/dec dword [r12 + valueA]
+};
+static constexpr Hole kIntUnaryHoles[] = { { 2, HoleKind::Op }, { 4, HoleKind::ValueA } };
+
+static constexpr uint8_t kIntCompareExitCode[] = {
+  kRexInt, 0x8B, 0x84, 0x24, 0, 0, 0, 0,    // mov eax, [r12 + valueA]
+  kRexInt, 0x3B, 0x84, 0x24, 0, 0, 0, 0,    // cmp eax, [r12 + valueB]
+  0x0F, 0, 0, 0, 0, 0,                      // j<op> exit
+};
+static constexpr Hole kIntCompareExitHoles[] = {
+  { 4, HoleKind::ValueA }, { 12, HoleKind::ValueB }, { 17, HoleKind::Op }, { 18, HoleKind::Exit },
+};
+
+static constexpr uint8_t kBranchExitCode[] = {
+  JIT_CALL_STUB,
+  0x85, 0xC0,                               // test eax, eax
+  0x0F, 0, 0, 0, 0, 0,                      // j<op> exit
+};
+static constexpr Hole kBranchExitHoles[] = {
+  { 5, HoleKind::Insn }, { 15, HoleKind::Stub }, { 28, HoleKind::Op }, { 29, HoleKind::Exit },
+};
+// clang-format on
+
+#undef JIT_CALL_STUB
+
+static constexpr Stencil kCall = { kCallCode, kCallHoles };
+static constexpr Stencil kBranch = { kBranchCode, kBranchHoles };
+static constexpr Stencil kExit = { kExitCode, kExitHoles };
+static constexpr Stencil kCallExit = { kCallExitCode, kCallExitHoles };
+static constexpr Stencil kJump = { kJumpCode, kJumpHoles };
+static constexpr Stencil kIntArithImm = { kIntArithImmCode, kIntArithImmHoles };
+static constexpr Stencil kIntArith = { kIntArithCode, kIntArithHoles };
+static constexpr Stencil kIntBranch = { kIntBranchCode, kIntBranchHoles };
+static constexpr Stencil kGuardIntA = { kGuardIntACode, kGuardIntAHoles };
+static constexpr Stencil kGuardIntB = { kGuardIntBCode, kGuardIntBHoles };
+static constexpr Stencil kIntImm = { kIntImmCode, kIntImmHoles };
+static constexpr Stencil kIntReg = { kIntRegCode, kIntRegHoles };
+static constexpr Stencil kIntUnary = { kIntUnaryCode, kIntUnaryHoles };
+static constexpr Stencil kIntCompareExit = { kIntCompareExitCode, kIntCompareExitHoles };
+static constexpr Stencil kBranchExit = { kBranchExitCode, kBranchExitHoles };
+
+struct JitOp {
+  const Stencil* stencil = NULL; ///< NULL if the instruction compiles to nothing.
+  JitStub stub = NULL;
+  uint8_t op = 0;
+};
+
+// Selects the stencil and runtime stub of an opcode. Opcodes without one leave compiled code.
+static JitOp getJitOp( Opcode op ) {
+  // clang-format off
+  switch ( op ) {
+  case NOP:
+  case LBL:       return { NULL };
+  case ADD:       return { &kIntArith, stubArith, 0x01 };
+  case SUB:       return { &kIntArith, stubArith, 0x29 };
+  case MUL:
+  case DIV:
+  case MOD:
+  case POW:       return { &kCall, stubArith };
+  case IADD:      return { &kIntArithImm, stubIArith, 0x84 };
+  case ISUB:      return { &kIntArithImm, stubIArith, 0xAC };
+  case IMUL:
+  case IDIV:
+  case IMOD:
+  case IPOW:      return { &kCall, stubIArith };
+  case FADD:
+  case FSUB:
+  case FMUL:
+  case FDIV:
+  case FMOD:
+  case FPOW:      return { &kCall, stubFArith };
+  case NEG:       return { &kCall, stubNeg };
+  case MOV:       return { &kCall, stubMov };
+  case INC:       return { &kCall, stubInc };
+  case DEC:       return { &kCall, stubDec };
+  case LOADK:     return { &kCall, stubLoadK };
+  case LOADNIL:   return { &kCall, stubLoadNil };
+  case LOADI:     return { &kCall, stubLoadI };
+  case LOADF:     return { &kCall, stubLoadF };
+  case LOADBT:    return { &kCall, stubLoadBT };
+  case LOADBF:    return { &kCall, stubLoadBF };
+  case LOADARR:   return { &kCall, stubLoadArr };
+  case LOADDICT:  return { &kCall, stubLoadDict };
+  case GETUPV:    return { &kCall, stubGetUpv };
+  case SETUPV:    return { &kCall, stubSetUpv };
+  case PUSH:      return { &kCall, stubPush };
+  case PUSHK:     return { &kCall, stubPushK };
+  case PUSHNIL:   return { &kCall, stubPushNil };
+  case PUSHI:     return { &kCall, stubPushI };
+  case PUSHF:     return { &kCall, stubPushF };
+  case PUSHBT:    return { &kCall, stubPushBT };
+  case PUSHBF:    return { &kCall, stubPushBF };
+  case DROP:      return { &kCall, stubDrop };
+  case GETLOCAL:  return { &kCall, stubGetLocal };
+  case SETLOCAL:  return { &kCall, stubSetLocal };
+  case GETARG:    return { &kCall, stubGetArg };
+  case GETGLOBAL: return { &kCall, stubGetGlobal };
+  case SETGLOBAL: return { &kCall, stubSetGlobal };
+  case EQ:        return { &kCall, stubEq };
+  case DEQ:       return { &kCall, stubDeq };
+  case NEQ:       return { &kCall, stubNeq };
+  case AND:       return { &kCall, stubAnd };
+  case OR:        return { &kCall, stubOr };
+  case NOT:       return { &kCall, stubNot };
+  case LT:        return { &kCall, stubCompare<std::less<>> };
+  case GT:        return { &kCall, stubCompare<std::greater<>> };
+  case LTEQ:      return { &kCall, stubCompare<std::less_equal<>> };
+  case GTEQ:      return { &kCall, stubCompare<std::greater_equal<>> };
+  case JMP:       return { &kJump };
+  case JMPIF:     return { &kBranch, stubJmpIf };
+  case JMPIFN:    return { &kBranch, stubJmpIfN };
+  case JMPIFEQ:   return { &kBranch, stubJmpIfEq };
+  case JMPIFNEQ:  return { &kBranch, stubJmpIfNeq };
+  case JMPIFLT:   return { &kIntBranch, stubJmpIfCompare<std::less<>>, 0x8C };
+  case JMPIFGT:   return { &kIntBranch, stubJmpIfCompare<std::greater<>>, 0x8F };
+  case JMPIFLTEQ: return { &kIntBranch, stubJmpIfCompare<std::less_equal<>>, 0x8E };
+  case JMPIFGTEQ: return { &kIntBranch, stubJmpIfCompare<std::greater_equal<>>, 0x8D };
+  case GETARR:    return { &kCallExit, stubGetArr };
+  case SETARR:    return { &kCallExit, stubSetArr };
+  case NEXTARR:   return { &kCall, stubNextArr };
+  case LENARR:    return { &kCall, stubLenArr };
+  case APPENDARR: return { &kCallExit, stubAppendArr };
+  case POPARR:    return { &kCall, stubPopArr };
+  case GETDICT:   return { &kCallExit, stubGetDict };
+  case SETDICT:   return { &kCallExit, stubSetDict };
+  case GETDICTK:  return { &kCallExit, stubGetDictK };
+  case SETDICTK:  return { &kCallExit, stubSetDictK };
+  case NEXTDICT:  return { &kCall, stubNextDict };
+  case LENDICT:   return { &kCall, stubLenDict };
+  case LENSTR:    return { &kCall, stubLenStr };
+  case CONSTR:    return { &kCall, stubConStr };
+  case STRCAST:
+  case BCAST:     return { &kCall, stubStrCast };
+  default:        return { &kExit, stubExit };
+  } // clang-format on
+}
+
+// Returns the jump offset of a jump instruction.
+static int16_t getJumpOffset( const Instruction& insn ) {
+  switch ( insn.op ) {
+  case JMP:
+    return (int16_t)insn.a;
+  case JMPIF:
+  case JMPIFN:
+    return (int16_t)insn.b;
+  default:
+    return (int16_t)insn.c;
+  }
+}
+
+// Machine code under construction. Jump and exit displacements refer to labels, and are resolved
+// once every label has been placed.
+struct CodeBuffer {
+  struct Fixup {
+    size_t offset; ///< Offset of the rel32 displacement.
+    size_t label;  ///< Label the displacement refers to.
+  };
+
+  std::vector<uint8_t> code;
+  std::vector<Fixup> fixups;
+  std::vector<uint32_t> labels;
+};
+
+// Values of the holes of a stencil.
+struct StencilArgs {
+  const Instruction* insn = NULL;
+  JitStub stub = NULL;
+  uint8_t op = 0;
+  size_t target = 0; ///< Label of Target holes.
+  size_t exit = 0;   ///< Label of Exit holes.
+};
+
+template<typename T>
+static void patch( std::vector<uint8_t>& code, size_t offset, T value ) {
+  std::memcpy( code.data() + offset, &value, sizeof( T ) );
+}
+
+static uint32_t registerOffset( uint16_t reg, size_t field ) {
+  return (uint32_t)( reg * sizeof( Value ) + field );
+}
+
+static void emit( CodeBuffer* cb, const Stencil& stencil, const StencilArgs& args ) {
+  const Instruction* insn = args.insn;
+  size_t base = cb->code.size();
+
+  cb->code.insert( cb->code.end(), stencil.code.begin(), stencil.code.end() );
+
+  for ( const Hole& hole : stencil.holes ) {
+    size_t at = base + hole.offset;
+
+    switch ( hole.kind ) {
+    case HoleKind::Insn:
+      patch( cb->code, at, (uint64_t)insn );
+      break;
+    case HoleKind::Stub:
+      patch( cb->code, at, (uint64_t)args.stub );
+      break;
+    case HoleKind::TypeA:
+      patch( cb->code, at, registerOffset( insn->a, offsetof( Value, type ) ) );
+      break;
+    case HoleKind::TypeB:
+      patch( cb->code, at, registerOffset( insn->b, offsetof( Value, type ) ) );
+      break;
+    case HoleKind::ValueA:
+      patch( cb->code, at, registerOffset( insn->a, offsetof( Value, u ) ) );
+      break;
+    case HoleKind::ValueB:
+      patch( cb->code, at, registerOffset( insn->b, offsetof( Value, u ) ) );
+      break;
+    case HoleKind::Imm:
+      patch( cb->code, at, ( (uint32_t)insn->c << 16 ) | insn->b );
+      break;
+    case HoleKind::Op:
+      patch( cb->code, at, args.op );
+      break;
+    case HoleKind::Target:
+      cb->fixups.push_back( { at, args.target } );
+      break;
+    case HoleKind::Exit:
+      cb->fixups.push_back( { at, args.exit } );
+      break;
+    }
+  }
+}
+
+static void emitBytes( CodeBuffer* cb, std::span<const uint8_t> bytes ) {
+  cb->code.insert( cb->code.end(), bytes.begin(), bytes.end() );
+}
+
+static void placeLabel( CodeBuffer* cb, size_t label ) {
+  cb->labels[label] = (uint32_t)cb->code.size();
+}
+
+// Resolves displacements and copies the code into executable memory.
+static bool link( CodeBuffer* cb, uint8_t** native, size_t* nativeSize ) {
+  for ( const CodeBuffer::Fixup& fixup : cb->fixups ) {
+    int64_t target = cb->labels[fixup.label];
+    patch( cb->code, fixup.offset, (int32_t)( target - (int64_t)( fixup.offset + 4 ) ) );
+  }
+
+  size_t pageSize = (size_t)sysconf( _SC_PAGESIZE );
+  size_t mapSize = ( cb->code.size() + pageSize - 1 ) & ~( pageSize - 1 );
+
+  void* mem = mmap( NULL, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+  if ( mem == MAP_FAILED ) {
+    return false;
+  }
+
+  std::memcpy( mem, cb->code.data(), cb->code.size() );
+
+  if ( mprotect( mem, mapSize, PROT_READ | PROT_EXEC ) != 0 ) {
+    munmap( mem, mapSize );
+    return false;
+  }
+
+  *native = (uint8_t*)mem;
+  *nativeSize = mapSize;
+  return true;
+}
+
+static bool isJumpStencil( const Stencil* stencil ) {
+  return stencil == &kJump || stencil == &kBranch || stencil == &kIntBranch;
+}
+
+// Labels of a compiled function are its instructions, followed by the epilogue.
+static bool compileFunction( JitFunction* jfn ) {
+  CodeBuffer cb;
+  size_t epilogue = jfn->size;
+
+  cb.labels.resize( jfn->size + 1 );
+  emitBytes( &cb, kPrologue );
+
+  for ( size_t i = 0; i < jfn->size; i++ ) {
+    const Instruction* insn = jfn->code + i;
+    JitOp jop = getJitOp( insn->op );
+    int64_t target = (int64_t)i + getJumpOffset( *insn );
+
+    // Jumps leaving the function are left to the interpreter.
+    if ( isJumpStencil( jop.stencil ) && ( target < 0 || target >= (int64_t)jfn->size ) ) {
+      jop = { &kExit, stubExit };
+    }
+
+    placeLabel( &cb, i );
+
+    if ( jop.stencil != NULL ) {
+      emit( &cb, *jop.stencil, { insn, jop.stub, jop.op, (size_t)target, epilogue } );
+    }
+  }
+
+  // Falling off the end of the function continues in the interpreter, like it would have.
+  emit( &cb, kExit, { jfn->code + jfn->size, stubExit, 0, 0, epilogue } );
+
+  placeLabel( &cb, epilogue );
+  emitBytes( &cb, kEpilogue );
+
+  if ( !link( &cb, &jfn->native, &jfn->nativeSize ) ) {
+    return false;
+  }
+
+  for ( size_t i = 0; i < jfn->size; i++ ) {
+    jfn->labels[i] = cb.labels[i];
+  }
+
+  return true;
+}
+
+JitCache::~JitCache() {
+  for ( auto& [code, jfn] : functions ) {
+    if ( jfn.native != NULL ) {
+      munmap( jfn.native, jfn.nativeSize );
+    }
+  }
+}
+
+const JitFunction* jitCompile( State* state, const Function& fn ) {
+  auto it = state->jitCache.functions.find( fn.code );
+  if XVM_LIKELY ( it != state->jitCache.functions.end() ) {
+    return it->second.native != NULL ? &it->second : NULL;
+  }
+
+  JitFunction& jfn = state->jitCache.functions[fn.code];
+  jfn.code = fn.code;
+  jfn.size = fn.size;
+  jfn.labels.resize( fn.size );
+
+  // Failed compilations are cached too, so that they are not retried on every call.
+  return compileFunction( &jfn ) ? &jfn : NULL;
+}
+
+void jitRun( State* state, const JitFunction* jfn ) {
+  size_t index = state->pc - jfn->code;
+  JitEntry entry = reinterpret_cast<JitEntry>( jfn->native );
+
+  entry( state, jfn->native + jfn->labels[index], state->regBase );
+}
+
+// Trace recording state of a loop header.
+static constexpr uint16_t kTraceCompiled = UINT16_MAX;
+static constexpr uint16_t kTraceBlacklisted = UINT16_MAX - 1;
+
+// An instruction of a recorded trace, with the operand types observed before executing it.
+struct TraceEntry {
+  const Instruction* insn;
+  ValueKind kindA = ValueKind::Nil;
+  ValueKind kindB = ValueKind::Nil;
+  bool taken; ///< Whether a conditional jump was taken.
+};
+
+static bool isTraceable( Opcode op ) {
+  return getJitOp( op ).stencil != &kExit;
+}
+
+static bool isConditionalJump( Opcode op ) {
+  return op >= JMPIF && op <= JMPIFGTEQ;
+}
+
+// Records the path taken by one iteration of the loop starting at state->pc, by executing it
+// instruction by instruction in the interpreter. Recording fails if the path leaves the function,
+// may raise an error or exceeds kMaxTraceLength; the state is valid either way.
+static bool recordTrace( State* state, std::vector<TraceEntry>* trace ) {
+  const Instruction* header = state->pc;
+
+  while ( trace->size() < kMaxTraceLength ) {
+    const Instruction* insn = state->pc;
+
+    if ( !isTraceable( insn->op ) ) {
+      return false;
+    }
+
+    TraceEntry entry;
+    entry.insn = insn;
+    // Only read the kinds of operands that name registers; others may be past the window.
+    const uint8_t operands = getRegisterOperands( insn->op );
+    if ( operands & kRegisterA ) {
+      entry.kindA = JIT_REG( insn->a )->kind();
+    }
+    if ( operands & kRegisterB ) {
+      entry.kindB = JIT_REG( insn->b )->kind();
+    }
+
+    executeStep( *state );
+
+    entry.taken = state->pc != insn + 1;
+    trace->push_back( entry );
+
+    if ( state->pc == header ) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// Returns the inverse of a jcc condition code (the lowest bit flips the condition).
+static uint8_t invertCondition( uint8_t cc ) {
+  return cc ^ 1;
+}
+
+// Labels of a trace are its loop start, the epilogue and one per side exit.
+static bool compileTrace( const std::vector<TraceEntry>& trace, Trace* out ) {
+  enum : size_t { LoopStart, Epilogue, FirstExit };
+
+  CodeBuffer cb;
+  std::vector<const Instruction*> exits;
+
+  auto sideExit = [&]( const Instruction* pc ) {
+    exits.push_back( pc );
+    cb.labels.push_back( 0 );
+    return FirstExit + exits.size() - 1;
+  };
+
+  cb.labels.resize( FirstExit );
+  emitBytes( &cb, kPrologue );
+  placeLabel( &cb, LoopStart );
+
+  for ( const TraceEntry& entry : trace ) {
+    const Instruction* insn = entry.insn;
+    Opcode op = insn->op;
+    JitOp jop = getJitOp( op );
+    bool intA = entry.kindA == ValueKind::Int;
+    bool intB = entry.kindB == ValueKind::Int;
+
+    // Type guards leave the trace before the instruction is executed.
+    auto guard = [&]( bool b ) {
+      size_t exit = sideExit( insn );
+      emit( &cb, kGuardIntA, { insn, NULL, 0, 0, exit } );
+      if ( b ) {
+        emit( &cb, kGuardIntB, { insn, NULL, 0, 0, exit } );
+      }
+    };
+
+    if ( ( op == IADD || op == ISUB ) && intA ) {
+      guard( false );
+      emit( &cb, kIntImm, { insn, NULL, jop.op } );
+    }
+    else if ( ( op == ADD || op == SUB ) && intA && intB ) {
+      guard( true );
+      emit( &cb, kIntReg, { insn, NULL, jop.op } );
+    }
+    else if ( ( op == INC || op == DEC ) && intA ) {
+      guard( false );
+      emit( &cb, kIntUnary, { insn, NULL, op == INC ? (uint8_t)0x84 : (uint8_t)0x8C } );
+    }
+    else if ( jop.stencil == &kIntBranch && intA && intB ) {
+      guard( true );
+
+      // Leave the trace when the jump goes the other way than it did while recording.
+      const Instruction* other = entry.taken ? insn + 1 : insn + getJumpOffset( *insn );
+      uint8_t cc = entry.taken ? invertCondition( jop.op ) : jop.op;
+      emit( &cb, kIntCompareExit, { insn, NULL, cc, 0, sideExit( other ) } );
+    }
+    else if ( jop.stencil == &kCallExit ) {
+      // Instructions left to the interpreter leave the trace before they execute.
+      emit( &cb, kCallExit, { insn, jop.stub, 0, 0, sideExit( insn ) } );
+    }
+    else if ( isConditionalJump( op ) ) {
+      const Instruction* other = entry.taken ? insn + 1 : insn + getJumpOffset( *insn );
+      uint8_t cc = entry.taken ? 0x84 /*jz*/ : 0x85 /*jnz*/;
+      emit( &cb, kBranchExit, { insn, jop.stub, cc, 0, sideExit( other ) } );
+    }
+    else if ( jop.stencil != NULL && jop.stencil != &kJump ) {
+      // Everything else calls its runtime stub; unconditional jumps are implied by the path.
+      emit( &cb, kCall, { insn, jop.stub } );
+    }
+  }
+
+  emit( &cb, kJump, { NULL, NULL, 0, LoopStart } );
+
+  for ( size_t i = 0; i < exits.size(); i++ ) {
+    placeLabel( &cb, FirstExit + i );
+    emit( &cb, kExit, { exits[i], stubExit, 0, 0, Epilogue } );
+  }
+
+  placeLabel( &cb, Epilogue );
+  emitBytes( &cb, kEpilogue );
+
+  out->entry = cb.labels[LoopStart];
+  return link( &cb, &out->native, &out->nativeSize );
+}
+
+static void runTrace( State* state, const Trace* trace ) {
+  JitEntry entry = reinterpret_cast<JitEntry>( trace->native );
+  entry( state, trace->native + trace->entry, state->regBase );
+}
+
+TraceCache::~TraceCache() {
+  for ( auto& [header, trace] : traces ) {
+    munmap( trace.native, trace.nativeSize );
+  }
+}
+
+void traceLoop( State* state ) {
+  TraceCache& cache = state->traceCache;
+
+  if XVM_UNLIKELY ( cache.counters.empty() ) {
+    cache.counters.resize( state->bcHolder.size() );
+  }
+
+  const Instruction* header = state->pc;
+  uint16_t& counter = cache.counters[header - state->bcHolder.data()];
+
+  if ( counter == kTraceCompiled ) {
+    runTrace( state, &cache.traces[header] );
+    return;
+  }
+
+  if ( counter == kTraceBlacklisted || ++counter < kHotLoopThreshold ) {
+    return;
+  }
+
+  std::vector<TraceEntry> trace;
+  Trace compiled;
+
+  if ( !recordTrace( state, &trace ) || !compileTrace( trace, &compiled ) ) {
+    counter = kTraceBlacklisted;
+    return;
+  }
+
+  counter = kTraceCompiled;
+  cache.traces[header] = compiled;
+
+  // Recording left the state at the loop header again.
+  runTrace( state, &cache.traces[header] );
+}
+
+} // namespace xvm
+
+#endif
@@ -0,0 +1,123 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+/**
+ * @file jit.h
+ * @brief Declares the copy-and-patch baseline JIT.
+ *
+ * The baseline JIT translates a function into native code by copying a precompiled machine-code
+ * stencil for every instruction into executable memory, and patching its holes with the
+ * instruction operands, jump targets and addresses of the runtime stubs that implement slow paths.
+ * Instructions without a stencil (calls, returns, closures and anything that may raise an error)
+ * leave compiled code and are executed by the interpreter.
+ */
+#ifndef XVM_JIT_H
+#define XVM_JIT_H
+
+#include "xvm_common.h"
+#include "xvm_instruction.h"
+#include "xvm_value.h"
+
+/**
+ * @brief Whether the baseline JIT is available. Stencils are encoded for x86-64 System V, so it
+ * is only available on x86-64 Linux with GCC or Clang. Stencils also hardcode the tagged union
+ * layout of values, so it is unavailable with NaN-boxing.
+ */
+#ifndef XVM_JIT
+#if ( XVMC == CGCC || XVMC == CCLANG ) && defined( __x86_64__ ) && defined( __linux__ ) &&         \
+  !XVM_NANBOX
+#define XVM_JIT 1
+#else
+#define XVM_JIT 0
+#endif
+#endif
+
+/**
+ * @namespace xvm
+ * @ingroup xvm_namespace
+ * @{
+ */
+namespace xvm {
+
+struct State;
+struct Function;
+
+inline constexpr uint16_t kHotLoopThreshold = 1000; ///< Back-edges taken before tracing a loop.
+inline constexpr size_t kMaxTraceLength = 256;     ///< Maximum number of instructions in a trace.
+
+/**
+ * @struct JitFunction
+ * @brief Native code of a compiled function.
+ */
+struct JitFunction {
+  const Instruction* code = NULL; ///< First instruction of the function.
+  size_t size = 0;                ///< Number of instructions.
+
+  uint8_t* native = NULL;       ///< Executable memory holding the native code.
+  size_t nativeSize = 0;        ///< Size of the executable mapping.
+  std::vector<uint32_t> labels; ///< Native code offset of every instruction.
+};
+
+/**
+ * @struct JitCache
+ * @brief Compiled functions of a state, keyed by their first instruction.
+ */
+struct JitCache {
+  std::unordered_map<const Instruction*, JitFunction> functions; ///< Compiled functions.
+
+  JitCache() = default;
+  ~JitCache();
+
+  XVM_NOCOPY( JitCache );
+  XVM_NOMOVE( JitCache );
+};
+
+/**
+ * @struct Trace
+ * @brief Native code of a recorded loop iteration.
+ */
+struct Trace {
+  uint8_t* native = NULL; ///< Executable memory holding the native code.
+  size_t nativeSize = 0;  ///< Size of the executable mapping.
+  uint32_t entry = 0;     ///< Native code offset of the loop start.
+};
+
+/**
+ * @struct TraceCache
+ * @brief Back-edge counters and compiled traces of a state, keyed by loop header.
+ */
+struct TraceCache {
+  std::vector<uint16_t> counters;                        ///< Back-edge counters by instruction.
+  std::unordered_map<const Instruction*, Trace> traces; ///< Compiled traces.
+
+  TraceCache() = default;
+  ~TraceCache();
+
+  XVM_NOCOPY( TraceCache );
+  XVM_NOMOVE( TraceCache );
+};
+
+/**
+ * @brief Returns the compiled code of a function, compiling it on first use. Returns NULL if the
+ * function could not be compiled.
+ */
+const JitFunction* jitCompile( State* state, const Function& fn );
+
+/**
+ * @brief Runs compiled code starting at the instruction state->pc points to, until reaching an
+ * instruction that must be executed by the interpreter. state->pc is left pointing to it.
+ */
+void jitRun( State* state, const JitFunction* jfn );
+
+/**
+ * @brief Called by the interpreter when taking a backward jump to state->pc. Counts the back-edge,
+ * records and compiles a trace of the loop once it becomes hot, and runs the compiled trace of the
+ * loop if there is one. state->pc is left pointing to the instruction to continue at.
+ */
+void traceLoop( State* state );
+
+} // namespace xvm
+
+/** @} */
+
+#endif
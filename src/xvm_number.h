@@ -0,0 +1,59 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+/**
+ * @file number.h
+ * @brief Declares the numeric policy of the virtual machine.
+ *
+ * Integer and float values are stored as `Integer` and `Real`, which are 32-bit by default and
+ * 64-bit (`int64_t` and `double`) when built with `XVM_WIDE_NUMBERS` enabled. Bytecode immediates
+ * are 32-bit in both modes, and widened when decoded.
+ */
+#ifndef XVM_NUMBER_H
+#define XVM_NUMBER_H
+
+#include "xvm_common.h"
+#include <bit>
+
+/**
+ * @brief Whether integers and floats are 64-bit. Incompatible with `XVM_NANBOX`, which only has
+ * room for 32-bit integers.
+ */
+#ifndef XVM_WIDE_NUMBERS
+#define XVM_WIDE_NUMBERS 0
+#endif
+
+/**
+ * @namespace xvm
+ * @ingroup xvm_namespace
+ * @{
+ */
+namespace xvm {
+
+#if XVM_WIDE_NUMBERS
+using Integer = int64_t; ///< Integer value type.
+using Real = double;     ///< Float value type.
+#else
+using Integer = int; ///< Integer value type.
+using Real = float;  ///< Float value type.
+#endif
+
+/**
+ * @brief Decodes a signed 32-bit integer immediate split across two operands.
+ */
+inline Integer decodeIntImmediate( uint16_t hi, uint16_t lo ) {
+  return (int32_t)( ( (uint32_t)hi << 16 ) | lo );
+}
+
+/**
+ * @brief Decodes a single precision float immediate split across two operands, as raw bits.
+ */
+inline Real decodeFloatImmediate( uint16_t hi, uint16_t lo ) {
+  return std::bit_cast<float>( ( (uint32_t)hi << 16 ) | lo );
+}
+
+} // namespace xvm
+
+/** @} */
+
+#endif
@@ -5,6 +5,7 @@
 #define XVM_OPCODE_H
 
 #include "xvm_common.h"
+#include "xvm_superinsn.h"
 
 /**
  * @namespace xvm
@@ -88,6 +89,7 @@ enum class Opcode : uint16_t {
   JMPIFGTEQ,
   CALL,
   PCALL,
+  TAILCALL,
   RET,
   RETBT,
   RETBF,
@@ -96,10 +98,14 @@ enum class Opcode : uint16_t {
   SETARR,
   NEXTARR,
   LENARR,
+  APPENDARR,
+  POPARR,
   GETDICT,
   SETDICT,
   NEXTDICT,
   LENDICT,
+  GETDICTK,
+  SETDICTK,
   CONSTR,
   GETSTR,
   SETSTR,
@@ -108,8 +114,192 @@ enum class Opcode : uint16_t {
   FCAST,
   STRCAST,
   BCAST,
+
+  // Type-specialized variants of arithmetic and comparison opcodes. These are never emitted into
+  // bytecode; the interpreter rewrites generic instructions into them in place after observing
+  // their operand types (int-int or float-float), and back if the types change.
+  ADDII,
+  ADDFF,
+  SUBII,
+  SUBFF,
+  MULII,
+  MULFF,
+  DIVII,
+  DIVFF,
+  MODII,
+  MODFF,
+  POWII,
+  POWFF,
+  LTII,
+  LTFF,
+  GTII,
+  GTFF,
+  LTEQII,
+  LTEQFF,
+  GTEQII,
+  GTEQFF,
+  JMPIFLTII,
+  JMPIFLTFF,
+  JMPIFGTII,
+  JMPIFGTFF,
+  JMPIFLTEQII,
+  JMPIFLTEQFF,
+  JMPIFGTEQII,
+  JMPIFGTEQFF,
+
+  // Superinstructions; fused sequences of frequently executed opcodes. Like quickened opcodes,
+  // these are never emitted into bytecode, see scripts/superinsn.py.
+#define XVM_SUPERINSN_OPCODE( name, ... ) name,
+  XVM_SUPERINSN_LIST( XVM_SUPERINSN_OPCODE )
+#undef XVM_SUPERINSN_OPCODE
+};
+
+/**
+ * @enum RegisterOperand
+ * @ingroup xvm_namespace
+ * @brief Operands of an instruction that name registers, see getRegisterOperands().
+ */
+enum RegisterOperand : uint8_t {
+  kRegisterA = 1 << 0,
+  kRegisterB = 1 << 1,
+  kRegisterC = 1 << 2,
 };
 
+/**
+ * @brief Returns the mask of `RegisterOperand`s of an opcode. Other operands are immediates,
+ * constant indices, jump offsets or unused. The `b` operand of calls is the register holding the
+ * first argument, see `Function::regCount`.
+ */
+constexpr uint8_t getRegisterOperands( Opcode op ) {
+  using enum Opcode;
+
+  constexpr uint8_t A = kRegisterA, AB = kRegisterA | kRegisterB;
+  constexpr uint8_t ABC = kRegisterA | kRegisterB | kRegisterC;
+
+  switch ( op ) {
+  case ADD:
+  case SUB:
+  case MUL:
+  case DIV:
+  case MOD:
+  case POW:
+  case ADDII:
+  case ADDFF:
+  case SUBII:
+  case SUBFF:
+  case MULII:
+  case MULFF:
+  case DIVII:
+  case DIVFF:
+  case MODII:
+  case MODFF:
+  case POWII:
+  case POWFF:
+  case MOV:
+  case GETGLOBAL:
+  case SETGLOBAL:
+  case NOT:
+  case JMPIFEQ:
+  case JMPIFNEQ:
+  case JMPIFLT:
+  case JMPIFGT:
+  case JMPIFLTEQ:
+  case JMPIFGTEQ:
+  case JMPIFLTII:
+  case JMPIFLTFF:
+  case JMPIFGTII:
+  case JMPIFGTFF:
+  case JMPIFLTEQII:
+  case JMPIFLTEQFF:
+  case JMPIFGTEQII:
+  case JMPIFGTEQFF:
+  case CALL:
+  case PCALL:
+  case TAILCALL:
+  case LENARR:
+  case APPENDARR:
+  case POPARR:
+  case LENDICT:
+  case GETDICTK:
+  case SETDICTK:
+  case CONSTR:
+  case GETSTR:
+  case LENSTR:
+  case ICAST:
+  case FCAST:
+  case STRCAST:
+  case BCAST:
+    return AB;
+  case IADD:
+  case FADD:
+  case ISUB:
+  case FSUB:
+  case IMUL:
+  case FMUL:
+  case IDIV:
+  case FDIV:
+  case IMOD:
+  case FMOD:
+  case IPOW:
+  case FPOW:
+  case NEG:
+  case LOADK:
+  case LOADNIL:
+  case LOADI:
+  case LOADF:
+  case LOADBT:
+  case LOADBF:
+  case LOADARR:
+  case LOADDICT:
+  case CLOSURE:
+  case PUSH:
+  case SETUPV:
+  case GETUPV:
+  case GETLOCAL:
+  case SETLOCAL:
+  case GETARG:
+  case INC:
+  case DEC:
+  case JMPIF:
+  case JMPIFN:
+  case RET:
+  case SETSTR:
+    return A;
+  case EQ:
+  case DEQ:
+  case NEQ:
+  case AND:
+  case OR:
+  case LT:
+  case GT:
+  case LTEQ:
+  case GTEQ:
+  case LTII:
+  case LTFF:
+  case GTII:
+  case GTFF:
+  case LTEQII:
+  case LTEQFF:
+  case GTEQII:
+  case GTEQFF:
+  case GETARR:
+  case SETARR:
+  case NEXTARR:
+  case GETDICT:
+  case SETDICT:
+  case NEXTDICT:
+    return ABC;
+    // Fused instructions keep the operands of their first instruction.
+#define XVM_SUPERINSN_OPERANDS( name, len, op0, ... )                                              \
+  case name:                                                                                       \
+    return getRegisterOperands( op0 );
+    XVM_SUPERINSN_LIST( XVM_SUPERINSN_OPERANDS )
+#undef XVM_SUPERINSN_OPERANDS
+  default:
+    return 0;
+  }
+}
+
 } // namespace xvm
 
 #endif
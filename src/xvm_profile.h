@@ -0,0 +1,52 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+/**
+ * @file profile.h
+ * @brief Declares the opcode sequence profiler used to select superinstructions.
+ *
+ * When built with `XVM_OPCODE_PROFILE` enabled, the interpreter records how often pairs and
+ * triples of adjacent instructions execute back to back. Profiles are dumped in a plain text
+ * format consumed by `scripts/superinsn.py`, which generates the superinstruction definitions in
+ * `xvm_superinsn.h`.
+ */
+#ifndef XVM_PROFILE_H
+#define XVM_PROFILE_H
+
+#include "xvm_common.h"
+#include "xvm_instruction.h"
+
+/**
+ * @brief Whether the interpreter records opcode sequence frequencies. Superinstructions are not
+ * fused in profiling builds, so that the profile reflects unfused bytecode.
+ */
+#ifndef XVM_OPCODE_PROFILE
+#define XVM_OPCODE_PROFILE 0
+#endif
+
+/**
+ * @namespace xvm
+ * @ingroup xvm_namespace
+ * @{
+ */
+namespace xvm {
+
+/**
+ * @struct OpcodeProfile
+ * @brief Execution frequencies of opcode pairs and triples.
+ *
+ * Only sequences of instructions that are adjacent in bytecode are recorded, as those are the only
+ * ones that can be fused. Keys pack opcodes into 16-bit lanes, first opcode in the highest lane.
+ */
+struct OpcodeProfile {
+  const Instruction* last[2] = { NULL, NULL }; ///< Last two executed instructions, newest first.
+
+  std::unordered_map<uint32_t, uint64_t> pairs;   ///< Pair frequencies.
+  std::unordered_map<uint64_t, uint64_t> triples; ///< Triple frequencies.
+};
+
+} // namespace xvm
+
+/** @} */
+
+#endif
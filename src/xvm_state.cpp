@@ -5,6 +5,9 @@
 #include "xvm_api_impl.h"
 #include "xvm_lib_base.h"
 
+#include <algorithm>
+#include <initializer_list>
+
 namespace xvm {
 
 using enum Opcode;
@@ -15,6 +18,7 @@ static void loadMainFunction( State* state ) {
   fun.line = 0;
   fun.code = state->bcHolder.data();
   fun.size = state->bcHolder.size();
+  fun.regCount = impl::__getRegisterCount( fun.code, fun.size );
 
   Callable c;
   c.type = CallableKind::Function;
@@ -22,9 +26,100 @@ static void loadMainFunction( State* state ) {
   c.arity = 1;
 
   Closure* cl = new Closure( std::move( c ) );
+  gcTrack( state, cl, ValueKind::Function );
   state->main = Value( cl );
 }
 
+// Interns string constants, so that the constants used as global names are canonical and their
+// lookups skip the string table. The canonical string of every constant is recorded, as a
+// constant whose contents were interned before is not canonical itself; keyed dictionary
+// instructions look their key up there, and never hash at runtime.
+static void internConstants( State* state ) {
+  state->constantKeys.resize( state->kHolder.size() );
+
+  for ( size_t i = 0; i < state->kHolder.size(); i++ ) {
+    const Value& k = state->kHolder[i];
+    if ( k.kind() == ValueKind::String ) {
+      state->constantKeys[i] = impl::__internString( state, k.asString() );
+    }
+  }
+}
+
+// Records the register window size of the function defined by every CLOSURE instruction, so that
+// creating a closure does not rescan its body.
+static void countClosureRegisters( State* state ) {
+  const std::vector<Instruction>& code = state->bcHolder;
+  state->closureRegCounts.resize( code.size() );
+
+  for ( size_t i = 0; i < code.size(); i++ ) {
+    if ( code[i].op == CLOSURE ) {
+      size_t size = std::min<size_t>( code[i].b, code.size() - i - 1 );
+      state->closureRegCounts[i] = (uint32_t)impl::__getRegisterCount( &code[i + 1], size );
+    }
+  }
+}
+
+// Translates the bytecode into the threaded instruction stream executed by the interpreter.
+// Handler addresses are private to the interpreter, and are resolved by it on first execution.
+static void loadThreadedCode( State* state ) {
+  for ( size_t i = 0; i < state->bcHolder.size(); i++ ) {
+    const Instruction& insn = state->bcHolder[i];
+    ThreadedInstruction& tinsn = state->threadedCode.data[i];
+
+    tinsn.op = insn.op;
+    tinsn.a = insn.a;
+    tinsn.b = insn.b;
+    tinsn.c = insn.c;
+  }
+}
+
+#if !XVM_OPCODE_PROFILE
+struct Superinstruction {
+  Opcode op;
+  size_t length;
+  Opcode seq[3];
+};
+
+#define XVM_SUPERINSN_ENTRY( name, length, op0, op1, op2 ) { name, length, { op0, op1, op2 } },
+
+// The list may be empty, which an array cannot be.
+static constexpr std::initializer_list<Superinstruction> superinstructions = {
+  XVM_SUPERINSN_LIST( XVM_SUPERINSN_ENTRY )
+};
+
+#undef XVM_SUPERINSN_ENTRY
+
+// Replaces the first instruction of every sequence matching a superinstruction with the
+// superinstruction, preferring the longest match. The remaining instructions of the sequence stay
+// in place, both as they carry their own operands and as they may be jump targets.
+static void fuseSuperinstructions( State* state ) {
+  size_t size = state->bcHolder.size();
+
+  for ( size_t i = 0; i < size; i++ ) {
+    const Superinstruction* match = NULL;
+
+    for ( const Superinstruction& si : superinstructions ) {
+      if ( i + si.length > size || ( match != NULL && match->length >= si.length ) ) {
+        continue;
+      }
+
+      bool matches = true;
+      for ( size_t j = 0; j < si.length && matches; j++ ) {
+        matches = state->bcHolder[i + j].op == si.seq[j];
+      }
+
+      if ( matches ) {
+        match = &si;
+      }
+    }
+
+    if ( match != NULL ) {
+      state->threadedCode.data[i].op = match->op;
+    }
+  }
+}
+#endif
+
 State::State(
   const std::vector<Value>& kHolder,
   const std::vector<Instruction>& bcHolder,
@@ -33,22 +128,52 @@ State::State(
   : globalEnv( new Dict ),
     kHolder( kHolder ),
     bcHolder( bcHolder ),
-    bcInfoHolder( bcInfoHolder ) {
+    bcInfoHolder( bcInfoHolder ),
+    threadedCode( bcHolder.size() ),
+    fieldCache( bcHolder.size() ) {
 
   stackTop = stack.data;
   stackBase = stack.data;
+  regBase = registers.data;
+  regTop = registers.data;
 
   callInfoTop = callInfoStack.data;
 
+  internConstants( this );
+  countClosureRegisters( this );
+  loadThreadedCode( this );
+#if !XVM_OPCODE_PROFILE
+  fuseSuperinstructions( this );
+#endif
   loadBaseLib( this );
   loadMainFunction( this );
 
   // Call main
-  impl::__call( this, main.u.clsr );
+  impl::__call( this, main.asClosure() );
 }
 
 State::~State() {
+  // Release the closures of frames that never returned (e.g. after EXIT).
+  while ( callInfoTop > callInfoStack.data ) {
+    impl::__popCallInfo( this );
+  }
+
+  // Release the roots; tracked objects that are still alive afterwards only reference each other,
+  // and are released by a final collection.
+  for ( Value* val = registers.data; val < registers.data + registers.size; val++ ) {
+    impl::__resetValue( val );
+  }
+
+  for ( Value* val = stack.data; val < stack.data + stack.size; val++ ) {
+    impl::__resetValue( val );
+  }
+
+  impl::__resetValue( &main );
+
   delete globalEnv;
+  globalEnv = NULL;
+
+  gcCollect( this );
 }
 
 } // namespace xvm
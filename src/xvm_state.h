@@ -18,6 +18,10 @@
 #include "xvm_instruction.h"
 #include "xvm_value.h"
 #include "xvm_allocator.h"
+#include "xvm_profile.h"
+#include "xvm_jit.h"
+#include "xvm_gc.h"
+#include "xvm_string.h"
 
 /**
  * @namespace xvm
@@ -26,8 +30,8 @@
  */
 namespace xvm {
 
-/// Total amount of addressable registers (2^16)
-constexpr XVM_GLOBAL size_t kRegCount = 0xFFFF + 1;
+/// Total amount of registers, shared by the register windows of all active functions
+constexpr XVM_GLOBAL size_t kRegCount = 0x4000;
 
 constexpr XVM_GLOBAL size_t kMaxLocalCount = 200;
 
@@ -61,13 +65,35 @@ struct alignas( 64 ) State {
 
   Dict* globalEnv = NULL; ///< Global environment
 
-  TempObj<ErrorInfo> errorInfo; ///< Error info
-  TempBuf<Value> registers{ kRegCount };
+  ErrorInfo errorInfo; ///< Error info
+  GcHeap gc;           ///< Tracked objects and cycle collector
+  StringTable strings; ///< Interned strings
+  TempBuf<Value> registers{ kRegCount };          ///< Register file
   TempBuf<Value> stack{ kMaxLocalCount };         ///< Stack base
   TempBuf<CallInfo> callInfoStack{ kMaxCiCount }; ///< Call info stack
 
+  TempBuf<ThreadedInstruction> threadedCode; ///< Threaded translation of bcHolder
+  bool threaded = false;                     ///< Whether threadedCode handlers are resolved
+  std::vector<uint32_t> fieldCache;          ///< Inline cache of every instruction, by index
+  std::vector<String*> constantKeys;         ///< Canonical string of every string constant
+  std::vector<uint32_t> closureRegCounts;    ///< Register count of every CLOSURE body, by index
+
+  bool jit = false;      ///< Whether to execute functions with the baseline JIT, if available
+  bool traceJit = false; ///< Whether to compile hot loops into traces, if available
+
+#if XVM_JIT
+  JitCache jitCache;     ///< Compiled functions
+  TraceCache traceCache; ///< Compiled loop traces
+#endif
+
+#if XVM_OPCODE_PROFILE
+  OpcodeProfile opcodeProfile; ///< Executed opcode sequence frequencies
+#endif
+
   Value* stackTop = NULL;       ///< Top of the stack
   Value* stackBase = NULL;      ///< Base of the current function
+  Value* regBase = NULL;        ///< Register window of the current function
+  Value* regTop = NULL;         ///< End of the register window of the current function
   CallInfo* callInfoTop = NULL; ///< Top of the callinfo stack
   Instruction const* pc = NULL; ///< Program counter
 
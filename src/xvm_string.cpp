@@ -4,6 +4,13 @@
 #include "xvm_string.h"
 #include "xvm_api_impl.h"
 
+#include <array>
+#include <bit>
+
+#if XVM_SSE2
+#include <emmintrin.h>
+#endif
+
 namespace xvm {
 
 char* strdup( const char* str ) {
@@ -17,85 +24,279 @@ char* strdup( const std::string& str ) {
   return strdup( str.c_str() );
 }
 
-uint32_t strhash( const char* str ) {
-  static constexpr uint32_t BASE = 31u; // Prime number
-  static constexpr uint32_t MOD = 0xFFFFFFFFu;
+static constexpr uint32_t kHashBase = 31u; // Prime number
+static constexpr size_t kHashBlock = 16;
+
+// Powers of the hash base, used to fold a block of bytes into the hash at once.
+static constexpr std::array<uint32_t, kHashBlock + 1> kHashPowers = [] {
+  std::array<uint32_t, kHashBlock + 1> powers{};
+  powers[0] = 1;
+  for ( size_t i = 1; i < powers.size(); i++ ) {
+    powers[i] = powers[i - 1] * kHashBase;
+  }
+
+  return powers;
+}();
+
+// Folds a block of bytes into the hash. Unlike the byte-at-a-time recurrence, the products do not
+// depend on each other, so they are computed in parallel.
+static inline XVM_FORCEINLINE uint32_t hashBlock( uint32_t hash, const char* block ) {
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>( block );
+
+  uint32_t sum = 0;
+  for ( size_t i = 0; i < kHashBlock; i++ ) {
+    sum += bytes[i] * kHashPowers[kHashBlock - 1 - i];
+  }
+
+  return hash * kHashPowers[kHashBlock] + sum;
+}
+
+static inline XVM_FORCEINLINE uint32_t hashBytes( uint32_t hash, const char* data, size_t size ) {
+  size_t i = 0;
+  for ( ; i + kHashBlock <= size; i += kHashBlock ) {
+    hash = hashBlock( hash, data + i );
+  }
+
+  for ( ; i < size; i++ ) {
+    hash = hash * kHashBase + (unsigned char)data[i];
+  }
+
+  return hash;
+}
+
+// Hashes a null-terminated string and finds its length in a single pass. With SSE2, the string is
+// scanned for the terminator a block at a time. Loads are aligned, so they never cross into a page
+// the string does not touch; the bytes read around the string are never hashed, but the loads are
+// hidden from the address sanitizer.
+static XVM_NOSANITIZE uint32_t hashScan( const char* str, size_t* size ) {
+#if XVM_SSE2
+  const __m128i zero = _mm_setzero_si128();
+
+  // The first block starts before the string; ignore its leading bytes
+  size_t skip = (uintptr_t)str % kHashBlock;
+  const char* block = str - skip;
+
+  uint32_t mask = _mm_movemask_epi8(
+    _mm_cmpeq_epi8( _mm_load_si128( reinterpret_cast<const __m128i*>( block ) ), zero ) );
+  mask >>= skip;
+  if ( mask != 0 ) {
+    *size = std::countr_zero( mask );
+    return hashBytes( 0, str, *size );
+  }
+
+  uint32_t hash = hashBytes( 0, str, kHashBlock - skip );
+  block += kHashBlock;
+
+  while ( true ) {
+    mask = _mm_movemask_epi8(
+      _mm_cmpeq_epi8( _mm_load_si128( reinterpret_cast<const __m128i*>( block ) ), zero ) );
+    if ( mask != 0 ) {
+      break;
+    }
+
+    hash = hashBlock( hash, block );
+    block += kHashBlock;
+  }
 
+  size_t tail = std::countr_zero( mask );
+  *size = block + tail - str;
+  return hashBytes( hash, block, tail );
+#else
   uint32_t hash = 0;
-  while ( char chr = *str++ ) {
-    hash = ( hash * BASE + (uint32_t)chr ) % MOD;
+
+  const char* chr = str;
+  for ( ; *chr != '\0'; chr++ ) {
+    hash = hash * kHashBase + (unsigned char)*chr;
   }
 
+  *size = chr - str;
   return hash;
+#endif
+}
+
+uint32_t strhash( const char* str ) {
+  size_t size;
+  return hashScan( str, &size );
+}
+
+// Continues hashing from the hash of a prefix, so that strhash( b, strhash( a ) ) is the hash of
+// the concatenation of a and b.
+uint32_t strhash( const char* data, size_t size, uint32_t seed ) {
+  return hashBytes( seed, data, size );
 }
 
 uint32_t strhash( const std::string& str ) {
-  return strhash( str.c_str() );
+  return strhash( str.data(), str.size() );
+}
+
+uint32_t strhashlen( const char* str, size_t* size ) {
+  return hashScan( str, size );
+}
+
+// Returns the length of the run of bytes at the start of a buffer that stresc() copies as is.
+static size_t plainRun( const char* data, size_t size ) {
+  size_t i = 0;
+
+#if XVM_SSE2
+  // Compares are signed, so bytes from 0x80 up fail the lower bound
+  const __m128i lower = _mm_set1_epi8( 0x1f );
+  const __m128i upper = _mm_set1_epi8( 0x7f );
+  const __m128i backslash = _mm_set1_epi8( '\\' );
+  const __m128i quote = _mm_set1_epi8( '"' );
+
+  for ( ; i + kHashBlock <= size; i += kHashBlock ) {
+    __m128i chunk = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + i ) );
+    __m128i printable =
+      _mm_and_si128( _mm_cmpgt_epi8( chunk, lower ), _mm_cmplt_epi8( chunk, upper ) );
+    __m128i special =
+      _mm_or_si128( _mm_cmpeq_epi8( chunk, backslash ), _mm_cmpeq_epi8( chunk, quote ) );
+
+    uint32_t mask = ~_mm_movemask_epi8( _mm_andnot_si128( special, printable ) ) & 0xFFFF;
+    if ( mask != 0 ) {
+      return i + std::countr_zero( mask );
+    }
+  }
+#endif
+
+  for ( ; i < size; i++ ) {
+    unsigned char c = data[i];
+    if ( c < 0x20 || c >= 0x7f || c == '\\' || c == '"' ) {
+      break;
+    }
+  }
+
+  return i;
 }
 
 std::string stresc( const std::string& str ) {
-  std::ostringstream buf;
+  static constexpr char kHexDigits[] = "0123456789abcdef";
 
-  for ( unsigned char c : str ) {
+  std::string buf;
+  buf.reserve( str.size() );
+
+  // Copy runs of printable bytes at once, and escape the bytes that end them
+  for ( size_t i = 0; i < str.size(); ) {
+    size_t run = plainRun( str.data() + i, str.size() - i );
+    buf.append( str.data() + i, run );
+    i += run;
+
+    if ( i == str.size() ) {
+      break;
+    }
+
+    unsigned char c = str[i++];
     switch ( c ) {
       // clang-format off
-        case '\a': buf << "\\a"; break;
-        case '\b': buf << "\\b"; break;
-        case '\f': buf << "\\f"; break;
-        case '\n': buf << "\\n"; break;
-        case '\r': buf << "\\r"; break;
-        case '\t': buf << "\\t"; break;
-        case '\v': buf << "\\v"; break;
-        case '\\': buf << "\\\\"; break;
-        case '\"': buf << "\\\""; break;
+        case '\a': buf += "\\a"; break;
+        case '\b': buf += "\\b"; break;
+        case '\f': buf += "\\f"; break;
+        case '\n': buf += "\\n"; break;
+        case '\r': buf += "\\r"; break;
+        case '\t': buf += "\\t"; break;
+        case '\v': buf += "\\v"; break;
+        case '\\': buf += "\\\\"; break;
+        case '\"': buf += "\\\""; break;
     // clang-format on
     default:
-      // If the character is printable, output it directly.
-      // Otherwise, output it as a hex escape.
-      if ( std::isprint( c ) ) {
-        buf << c;
-      }
-      else {
-        buf << "\\x" << std::hex << std::setw( 2 ) << std::setfill( '0' ) << static_cast<int>( c );
-      }
-
+      // Not printable; output it as a hex escape
+      buf += "\\x";
+      buf += kHexDigits[c >> 4];
+      buf += kHexDigits[c & 0xf];
       break;
     }
   }
 
-  return buf.str();
+  return buf;
+}
+
+// Returns storage for a string of the given capacity, inline if it fits, and records the
+// capacity of the storage.
+static char* allocChars( String* str, size_t cap ) {
+  if ( cap < kStringInlineCapacity ) {
+    str->cap = kStringInlineCapacity - 1;
+    return str->chars;
+  }
+
+  str->cap = cap;
+  return new char[cap + 1];
+}
+
+static void freeChars( String* str ) {
+  if ( !str->isInline() ) {
+    delete[] str->data;
+  }
+}
+
+// Takes the characters of another string, leaving it empty. Heap storage changes owner, inline
+// characters are copied.
+static void stealChars( String* str, String* other ) {
+  if ( other->isInline() ) {
+    str->data = str->chars;
+    std::memcpy( str->chars, other->chars, other->size + 1 );
+  }
+  else {
+    str->data = other->data;
+  }
+
+  str->size = other->size;
+  str->cap = other->cap;
+  str->hash = other->hash;
+
+  other->data = other->chars;
+  other->chars[0] = '\0';
+  other->size = 0;
+  other->cap = kStringInlineCapacity - 1;
+  other->hash = 0;
+}
+
+String::String( const char* str ) {
+  hash = xvm::strhashlen( str, &size );
+  data = allocChars( this, size );
+  std::memcpy( data, str, size + 1 );
 }
 
-String::String( const char* str )
-  : data( xvm::strdup( str ) ),
-    size( std::strlen( str ) ),
-    hash( xvm::strhash( str ) ) {}
+String::String( size_t size )
+  : size( size ) {
+  data = allocChars( this, size );
+  std::memset( data, 0, size + 1 );
+}
 
 String::~String() {
-  delete[] data;
+  freeChars( this );
 }
 
-String::String( const String& other )
-  : data( xvm::strdup( other.data ) ),
-    size( other.size ),
-    hash( other.hash ) {}
+void String::reserve( size_t cap ) {
+  if ( cap <= this->cap ) {
+    return;
+  }
 
-String::String( String&& other )
-  : data( other.data ),
-    size( other.size ),
+  char* chars = new char[cap + 1];
+  std::memcpy( chars, data, size + 1 );
+
+  freeChars( this );
+  data = chars;
+  this->cap = cap;
+}
+
+String::String( const String& other )
+  : size( other.size ),
     hash( other.hash ) {
-  other.data = NULL;
-  other.size = 0;
-  other.hash = 0;
+  data = allocChars( this, size );
+  std::memcpy( data, other.data, size + 1 );
+}
+
+String::String( String&& other ) {
+  stealChars( this, &other );
 }
 
 String& String::operator=( const String& other ) {
   if ( this != &other ) {
-    delete[] data;
+    freeChars( this );
 
-    data = xvm::strdup( other.data );
+    data = allocChars( this, other.size );
     size = other.size;
     hash = other.hash;
+    std::memcpy( data, other.data, size + 1 );
   }
 
   return *this;
@@ -103,18 +304,38 @@ String& String::operator=( const String& other ) {
 
 String& String::operator=( String&& other ) {
   if ( this != &other ) {
-    delete[] data;
-
-    data = other.data;
-    size = other.size;
-    hash = other.hash;
-
-    other.data = NULL;
-    other.size = 0;
-    other.hash = 0;
+    freeChars( this );
+    stealChars( this, &other );
   }
 
   return *this;
 }
 
+size_t StringTable::Hash::operator()( const String* str ) const {
+  return str->hash;
+}
+
+size_t StringTable::Hash::operator()( const Key& key ) const {
+  return key.hash;
+}
+
+bool StringTable::Equal::operator()( const String* lhs, const String* rhs ) const {
+  return lhs->size == rhs->size && !std::memcmp( lhs->data, rhs->data, lhs->size );
+}
+
+bool StringTable::Equal::operator()( const Key& lhs, const String* rhs ) const {
+  return lhs.size == rhs->size && !std::memcmp( lhs.data, rhs->data, lhs.size );
+}
+
+bool StringTable::Equal::operator()( const String* lhs, const Key& rhs ) const {
+  return ( *this )( rhs, lhs );
+}
+
+StringTable::~StringTable() {
+  for ( String* str : strings ) {
+    str->table = NULL;
+    impl::__releaseString( str );
+  }
+}
+
 } // namespace xvm
@@ -7,11 +7,15 @@
  *
  * This is a constant-sized, heap-allocated, hash-cached string structure
  * designed for performance in dictionary lookups and language runtime .
+ * Short strings keep their characters inline, so they cost a single allocation.
+ * Heap storage may have spare capacity, so that strings built by repeated
+ * appends grow geometrically.
  */
 #ifndef XVM_STRING_H
 #define XVM_STRING_H
 
 #include "xvm_common.h"
+#include "xvm_gc.h"
 
 /**
  * @namespace xvm
@@ -24,21 +28,37 @@ char* strdup( const char* str );
 char* strdup( const std::string& str );
 
 uint32_t strhash( const char* str );
+uint32_t strhash( const char* data, size_t size, uint32_t seed = 0 );
 uint32_t strhash( const std::string& str );
+uint32_t strhashlen( const char* str, size_t* size );
 
 std::string stresc( const std::string& str );
 
+struct StringTable;
+
+/**
+ * @brief Capacity of the inline character buffer of strings, including the null terminator.
+ * Strings shorter than this are stored inline.
+ */
+inline constexpr size_t kStringInlineCapacity = 16;
+
 /**
  * @struct String
  * @brief Constant-sized owning string type used in the xvm runtime.
  *
  * This structure owns its character data, tracks its size, and caches a hash
- * value to accelerate dictionary operations and comparisons.
+ * value to accelerate dictionary operations and comparisons. The data of short
+ * strings points to the inline buffer of the string.
+ *
+ * Strings are shared between values and copied on write; copies start with a single reference.
  */
-struct String {
-  char* data = NULL; ///< Heap-allocated UTF-8 character data.
-  size_t size = 0;   ///< Number of bytes in the string (not null-terminated).
-  uint32_t hash = 0; ///< Cached hash for fast comparisons and dict lookup.
+struct String : GcObject {
+  char* data = NULL;                      ///< UTF-8 character data, null-terminated.
+  size_t size = 0;                        ///< Number of bytes in the string.
+  size_t cap = 0;                         ///< Bytes the storage can hold, excluding the terminator.
+  uint32_t hash = 0;                      ///< Cached hash for fast comparisons and dict lookup.
+  StringTable* table = NULL;              ///< Table the string is interned in, if any.
+  char chars[kStringInlineCapacity] = {}; ///< Inline storage of short strings.
 
   XVM_IMPLCOPY( String );
   XVM_IMPLMOVE( String );
@@ -48,7 +68,71 @@ struct String {
    * @param str The input C-string to copy.
    */
   String( const char* str );
+
+  /**
+   * @brief Constructs a new `String` holding `size` null bytes, to be filled in by the caller.
+   * The caller is responsible for computing the hash once the data is written.
+   * @param size The number of bytes in the string.
+   */
+  explicit String( size_t size );
   ~String();
+
+  /**
+   * @brief Grows the storage to hold at least `cap` bytes; never shrinks it.
+   * @param cap The number of bytes to make room for, excluding the terminator.
+   */
+  void reserve( size_t cap );
+
+  /**
+   * @brief Returns whether the characters are stored in the inline buffer.
+   */
+  bool isInline() const {
+    return data == chars;
+  }
+};
+
+/**
+ * @struct StringTable
+ * @brief Interned strings of a state.
+ *
+ * Every distinct string content maps to a single canonical `String`, which the table holds a
+ * reference to. Since that reference keeps them shared, canonical strings are never mutated in
+ * place, and two strings interned in the same table are equal exactly when they are the same
+ * object. Dictionary keys are always canonical strings.
+ */
+struct StringTable {
+  /**
+   * @struct Key
+   * @brief Contents of a string to look up.
+   */
+  struct Key {
+    const char* data;
+    size_t size;
+    uint32_t hash;
+  };
+
+  struct Hash {
+    using is_transparent = void;
+
+    size_t operator()( const String* str ) const;
+    size_t operator()( const Key& key ) const;
+  };
+
+  struct Equal {
+    using is_transparent = void;
+
+    bool operator()( const String* lhs, const String* rhs ) const;
+    bool operator()( const Key& lhs, const String* rhs ) const;
+    bool operator()( const String* lhs, const Key& rhs ) const;
+  };
+
+  std::unordered_set<String*, Hash, Equal> strings; ///< Canonical strings.
+
+  StringTable() = default;
+  ~StringTable();
+
+  XVM_NOCOPY( StringTable );
+  XVM_NOMOVE( StringTable );
 };
 
 } // namespace xvm
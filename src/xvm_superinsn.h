@@ -0,0 +1,17 @@
+// This file is a part of the XVM project
+// Copyright (C) 2025 XnLogical - Licensed under GNU GPL v3.0
+
+// Generated by scripts/superinsn.py, do not edit.
+
+#ifndef XVM_SUPERINSN_H
+#define XVM_SUPERINSN_H
+
+// X( name, length, op0, op1, op2 ); unused trailing opcodes are NOP.
+#define XVM_SUPERINSN_LIST( X )
+
+#endif
+
+// Fused handlers, expanded inside the interpreter loop.
+#ifdef XVM_SUPERINSN_HANDLERS
+
+#endif
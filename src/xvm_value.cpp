@@ -12,17 +12,62 @@ namespace xvm {
 
 using enum ValueKind;
 
+#if XVM_NANBOX
+Value::XVM_NIL : bits( box( Nil, 0 ) ) {}
+
+Value::Value( bool b )
+  : bits( box( Bool, b ) ) {}
+
+Value::Value( Integer x )
+  : bits( box( Int, (uint32_t)x ) ) {}
+
+Value::Value( Real x )
+  : bits( boxFloat( x ) ) {}
+
+Value::Value( struct String* ptr )
+  : bits( box( String, (uintptr_t)ptr ) ) {}
+
+Value::Value( struct Array* ptr )
+  : bits( box( Array, (uintptr_t)ptr ) ) {}
+
+Value::Value( struct Dict* ptr )
+  : bits( box( Dict, (uintptr_t)ptr ) ) {}
+
+Value::Value( Closure* ptr )
+  : bits( box( Function, (uintptr_t)ptr ) ) {}
+
+Value::Value( const char* str )
+  : Value( new struct String( str ) ) {}
+
+// Move constructor, transfer ownership based on type
+Value::Value( Value&& other )
+  : bits( other.bits ) {
+  other.setNil();
+}
+
+// Move-assignment operator, moves values from other object
+Value& Value::operator=( Value&& other ) {
+  if ( this != &other ) {
+    impl::__resetValue( this );
+
+    this->bits = other.bits;
+    other.setNil();
+  }
+
+  return *this;
+}
+#else
 Value::XVM_NIL : type( Nil ) {}
 
 Value::Value( bool b )
   : type( Bool ),
     u( { .b = b } ) {}
 
-Value::Value( int x )
+Value::Value( Integer x )
   : type( Int ),
     u( { .i = x } ) {}
 
-Value::Value( float x )
+Value::Value( Real x )
   : type( Float ),
     u( { .f = x } ) {}
 
@@ -68,6 +113,7 @@ Value& Value::operator=( Value&& other ) {
 
   return *this;
 }
+#endif
 
 Value::~Value() {
   impl::__resetValue( this );
@@ -13,6 +13,17 @@
 #define XVM_OBJECT_H
 
 #include "xvm_common.h"
+#include "xvm_number.h"
+#include <bit>
+#include <concepts>
+
+/**
+ * @brief Whether values are NaN-boxed into 8 bytes instead of a 16 byte tagged union. Requires
+ * 64-bit targets with 48-bit user space addresses.
+ */
+#ifndef XVM_NANBOX
+#define XVM_NANBOX 0
+#endif
 
 // MSVC is annoying with uninitialized members
 #if XVMC == CMSVC
@@ -53,8 +64,23 @@ enum class ValueKind : uint8_t {
  *
  * This type is used throughout the xvm VM to hold and manipulate values
  * of different types dynamically at runtime.
+ *
+ * The representation is selected at compile time by `XVM_NANBOX`; code outside of this header
+ * only uses the constructors, `kind()` and the accessors, which behave the same in both.
  */
 struct alignas( 8 ) Value {
+#if XVM_NANBOX
+  /**
+   * Floats are stored as doubles, with NaNs canonicalized to kCanonicalNaN. Every other kind is a
+   * negative quiet NaN, with the kind in bits 48-50 and the payload in the low 48 bits; pointers
+   * fit as user space addresses are 48 bits wide on supported targets.
+   */
+  static constexpr uint64_t kBoxTag = 0xFFF8000000000000ull;
+  static constexpr uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFull;
+  static constexpr uint64_t kCanonicalNaN = 0x7FF8000000000000ull;
+
+  uint64_t bits; ///< Boxed representation.
+#else
   /**
    * @enum Tag
    * @brief Discriminates the active member of the Value union.
@@ -66,14 +92,15 @@ struct alignas( 8 ) Value {
    * @brief Holds the actual value for the current tag.
    */
   union Un {
-    int i;         ///< Integer.
-    float f;       ///< Float.
+    Integer i;     ///< Integer.
+    Real f;        ///< Float.
     bool b;        ///< Boolean.
     String* str;   ///< Heap string pointer.
     Array* arr;    ///< Heap array pointer.
     Dict* dict;    ///< Heap dictionary pointer.
     Closure* clsr; ///< Function closure pointer.
   } u;
+#endif
 
   XVM_NOCOPY( Value );
   XVM_IMPLMOVE( Value );
@@ -85,8 +112,8 @@ struct alignas( 8 ) Value {
 
   // Primitive constructors
   explicit Value( bool b );       ///< Constructs a Bool.
-  explicit Value( int x );        ///< Constructs an Int.
-  explicit Value( float x );      ///< Constructs a Float.
+  explicit Value( Integer x );    ///< Constructs an Int.
+  explicit Value( Real x );       ///< Constructs a Float.
   explicit Value( String* ptr );  ///< Constructs a String.
   explicit Value( Array* ptr );   ///< Constructs an Array.
   explicit Value( Dict* ptr );    ///< Constructs a Dict.
@@ -94,8 +121,151 @@ struct alignas( 8 ) Value {
 
   // Constant constructors
   explicit Value( const char* str );
+
+  /// Constructs an Int from any other integral type.
+  template<std::integral T>
+    requires( !std::same_as<T, bool> )
+  explicit Value( T x )
+    : Value( (Integer)x ) {}
+
+  // Accessors; the kind of the value must match the accessor.
+  ValueKind kind() const;
+  Integer asInt() const;
+  Real asFloat() const;
+  bool asBool() const;
+  String* asString() const;
+  Array* asArray() const;
+  Dict* asDict() const;
+  Closure* asClosure() const;
+
+  // In-place updates of primitive values. They do not release the previous value, so they must
+  // only be used on values that do not hold an object.
+  void setNil();
+  void setInt( Integer x );
+  void setFloat( Real x );
+  void setBool( bool b );
+
+#if XVM_NANBOX
+  static constexpr uint64_t box( ValueKind kind, uint64_t payload ) {
+    return kBoxTag | ( (uint64_t)kind << 48 ) | payload;
+  }
+
+  static uint64_t boxFloat( double x ) {
+    return x != x ? kCanonicalNaN : std::bit_cast<uint64_t>( x );
+  }
+
+  template<typename T>
+  T* unboxPointer() const {
+    return reinterpret_cast<T*>( bits & kPayloadMask );
+  }
+#endif
 };
 
+#if XVM_NANBOX
+static_assert( sizeof( Value ) == 8, "NaN-boxed values must be 8 bytes" );
+static_assert( sizeof( Integer ) == 4, "NaN-boxed values require 32-bit integers" );
+
+inline ValueKind Value::kind() const {
+  return bits >= kBoxTag ? ValueKind( ( bits >> 48 ) & 0x7 ) : ValueKind::Float;
+}
+
+inline Integer Value::asInt() const {
+  return (Integer)(uint32_t)bits;
+}
+
+inline Real Value::asFloat() const {
+  return (Real)std::bit_cast<double>( bits );
+}
+
+inline bool Value::asBool() const {
+  return bits & 1;
+}
+
+inline String* Value::asString() const {
+  return unboxPointer<String>();
+}
+
+inline Array* Value::asArray() const {
+  return unboxPointer<Array>();
+}
+
+inline Dict* Value::asDict() const {
+  return unboxPointer<Dict>();
+}
+
+inline Closure* Value::asClosure() const {
+  return unboxPointer<Closure>();
+}
+
+inline void Value::setNil() {
+  bits = box( ValueKind::Nil, 0 );
+}
+
+inline void Value::setInt( Integer x ) {
+  bits = box( ValueKind::Int, (uint32_t)x );
+}
+
+inline void Value::setFloat( Real x ) {
+  bits = boxFloat( x );
+}
+
+inline void Value::setBool( bool b ) {
+  bits = box( ValueKind::Bool, b );
+}
+#else
+inline ValueKind Value::kind() const {
+  return type;
+}
+
+inline Integer Value::asInt() const {
+  return u.i;
+}
+
+inline Real Value::asFloat() const {
+  return u.f;
+}
+
+inline bool Value::asBool() const {
+  return u.b;
+}
+
+inline String* Value::asString() const {
+  return u.str;
+}
+
+inline Array* Value::asArray() const {
+  return u.arr;
+}
+
+inline Dict* Value::asDict() const {
+  return u.dict;
+}
+
+inline Closure* Value::asClosure() const {
+  return u.clsr;
+}
+
+inline void Value::setNil() {
+  type = ValueKind::Nil;
+  u = {};
+}
+
+inline void Value::setInt( Integer x ) {
+  type = ValueKind::Int;
+  u.i = x;
+}
+
+inline void Value::setFloat( Real x ) {
+  type = ValueKind::Float;
+  u.f = x;
+}
+
+inline void Value::setBool( bool b ) {
+  type = ValueKind::Bool;
+  u.b = b;
+}
+#endif
+
 } // namespace xvm
 
 /** @} */